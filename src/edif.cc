@@ -24,6 +24,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 #include "config.h"	// this should pick up the apl src version
 
@@ -34,13 +37,16 @@
 #include<iostream>
 #include<fstream>
 #include<string>
-#include<regex>
 
 
 #include "Native_interface.hh"
 
 
 #include "edif2.hh"
+#include "edif_var.hh"
+#include "edif_spawn.hh"
+#include "edif_read.hh"
+#include "edif_registry.hh"
 #include "gitversion.h"
 
 #ifdef HAVE_CONFIG_H
@@ -64,16 +70,6 @@ static bool is_lambda = false;
 static char *dir = NULL;
 static const Function *apl_function = NULL;
 static const UCS_string WHITESPACE = UTF8_string (" \n\t\r\f\v");
-static const string vname ("([A-Za-z∆⍙][A-Za-z0-9_¯∆⍙]*)");
-static const string space ("[ \\t]+");
-static const string optspace ("[ \\t]*");
-static const string leftarrow ("←");
-static const string assign ("("+vname+optspace+leftarrow+optspace+")?");
-static const string locals  ("((;.*)*)");
-static const regex niladic (assign+vname+optspace+locals);
-static const regex monadic (assign+vname+space+vname+optspace+locals);
-static const regex dyadic  (assign+vname+space+vname+space+
-			    vname+optspace+locals);
 
 
 
@@ -85,20 +81,7 @@ static bool
 close_fun (Cause cause, const NativeFunction * caller)
 {
   if (dir) {
-    DIR *path;
-    struct dirent *ent;
-    if ((path = opendir (dir)) != NULL) {
-      while ((ent = readdir (path)) != NULL) {
-	char *lfn;
-	asprintf (&lfn, "%s/%s", dir, ent->d_name);
-	unlink (lfn);
-	free (lfn);
-	lfn = NULL;
-      }
-      closedir (path);
-    } 
-
-    rmdir (dir);
+    reg_clear (dir);
     free (dir);
     dir = NULL;
   }
@@ -129,10 +112,11 @@ get_signature()
 
 static bool
 get_var (const char *fn, const char *base, Value_P B, Shape &shape,
-	 bool &is_char)
+	 bool &is_char, bool &nested)
 {
   bool rc = false;
   is_char = false;
+  nested = false;
   Value *val = B.get ();
   UCS_string str = val->get_UCS_ravel();
   while (str.back() <= ' ') str.pop_back();
@@ -142,31 +126,20 @@ get_var (const char *fn, const char *base, Value_P B, Shape &shape,
     //    Value *val = sym->get_val_wptr ().get ();
     //    Value *val = sym->get_value ().get ();
     if (val) {
-      if (val->is_simple ()) {
-	if (!val->is_empty ()) {
-	  is_char = val->is_char_array ();
-	  shape = val->get_shape ();
-	  PrintContext pctx = Workspace::get_PrintContext(PST_NONE);
-	  //pctx.set_style(PR_APL);
-	  PrintBuffer pb(*val, pctx, 0);
-    
-	  ofstream tfile;
-	  tfile.open (fn, ios::out);
-	  loop (l, pb.get_row_count ()) {
-	    UCS_string line = pb.get_line (l);
-	    /***
-	      pad char = APL character:  ⎕ (U+EEFB)
-	    ***/
-	    line.map_pad ();
-	    UTF8_string utf (line);
-	    tfile << utf << endl;
-	  }
-	  tfile.close ();
-	  rc = true;
+      if (!val->is_empty ()) {
+	is_char = val->is_char_array ();
+	shape = val->get_shape ();
+	nested = !is_plain (*val);
+	int fd = open (fn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd != -1) {
+	  const char *err =
+	    nested ? write_nested (fd, *val) : write_value (fd, *val);
+	  close (fd);
+	  if (err) cerr << err << endl;
+	  else rc = true;
 	}
-	else val = NULL;
       }
-      else cerr << "Nested variables are not supported\n";
+      else val = NULL;
     }
     if (!val) {
       ofstream tfile;
@@ -324,9 +297,7 @@ get_fcn (const char *fn, const char *ifn, const char *base,
     const UCS_string ucs = apl_function->canonical(false);
     UCS_string_vector tlines;
     ucs.to_vector(tlines);
-    ofstream tfile;
-    
-    tfile.open (fn, ios::out);
+    string text;			// written in one go
     char *semiloc = NULL;
     loop(row, tlines.size()) {
       const UCS_string & line = tlines[row];
@@ -343,78 +314,259 @@ get_fcn (const char *fn, const char *ifn, const char *base,
 	}
 	else {
 	  utf = UCS_string (utf, 2, string::npos);	// skip assignment
-	  tfile << ifn << "←{"
-		<< utf
-		<< (semiloc ?: "")
-		<< "}\n";
+	  text += ifn;
+	  text += "←{";
+	  text += utf.c_str ();
+	  text += semiloc ?: "";
+	  text += "}\n";
 	  break;
 	}
       }
-      else tfile << utf << endl;
+      else {
+	text += utf.c_str ();
+	text += "\n";
+      }
     }
-    tfile.close ();
+    if (semiloc) free (semiloc);
+    write_text (fn, text.data (), text.size (), 0600);
   }
   else {
-    ofstream tfile;
-    tfile.open (fn, ios::out);
-    if (is_lambda)
-      tfile << ifn << "←{ " << locals << "}";
-    else
-      tfile << base << endl;
-    tfile.close ();
+    string text;
+    if (is_lambda) {
+      text += ifn;
+      text += "←{ ";
+      text += locals;
+      text += "}";
+    }
+    else {
+      text += base;
+      text += "\n";
+    }
+    write_text (fn, text.data (), text.size (), 0600);
   }
 }
 
 static void
-cleanup (char *dir, UTF8_string base_name, char *fn)
+cleanup (const char *name, char *fn)
 {
-  DIR *path;
-  struct dirent *ent;
-  if ((path = opendir (dir)) != NULL) {
-    while ((ent = readdir (path)) != NULL) {
-      if (!strncmp (ent->d_name, base_name.c_str (),
-		    base_name.size ())) {
-	char *lfn;
-	asprintf (&lfn, "%s/%s", dir, ent->d_name);
-	unlink (lfn);
-	free (lfn);
-	lfn = NULL;
-      }
-    }
-    closedir (path);
-  } 
+  reg_forget (name);
   if (fn) {
     free (fn);
     fn = NULL;
   }
 }
 
+/***
+    Header scanning.  A header is
+
+	[R←] [A] F [B] [;locals]
+
+    where R may be {R}, A may be {A}, and F is a name, a name with an
+    axis, F[X], or an operator with its operands, (LO OP [RO]), OP also
+    taking an optional axis.  The scanner walks the UTF-8 text once,
+    without copying, and returns the function or operator name with the
+    locals (starting at the first ';'), or an empty name if the text is
+    not a header.
+***/
+
+typedef struct {
+  const char *b;
+  size_t	n;
+} span_s;
+
+static inline size_t
+name_char (const char *p, const char *e, bool first)
+{
+  unsigned char c = (unsigned char)*p;
+  if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) return 1;
+  if (!first && ((c >= '0' && c <= '9') || c == '_')) return 1;
+  if (!first && c == 0xc2 && e - p >= 2 && (unsigned char)p[1] == 0xaf)
+    return 2;							// ¯
+  if (c == 0xe2 && e - p >= 3) {
+    unsigned char c1 = (unsigned char)p[1];
+    unsigned char c2 = (unsigned char)p[2];
+    if ((c1 == 0x88 && c2 == 0x86) ||				// ∆
+	(c1 == 0x8d && c2 == 0x99)) return 3;			// ⍙
+  }
+  return 0;
+}
+
+static inline void
+skip_space (const char *&p, const char *e)
+{
+  while (p < e && (*p == ' ' || *p == '\t')) p++;
+}
+
+static bool
+scan_name (const char *&p, const char *e, span_s &nm)
+{
+  size_t l = (p < e) ? name_char (p, e, true) : 0;
+  if (!l) return false;
+  nm.b = p;
+  p += l;
+  while (p < e && (l = name_char (p, e, false))) p += l;
+  nm.n = p - nm.b;
+  return true;
+}
+
+static bool
+scan_punct (const char *&p, const char *e, char c)
+{
+  skip_space (p, e);
+  if (p >= e || *p != c) return false;
+  p++;
+  skip_space (p, e);
+  return true;
+}
+
+static inline bool
+scan_arrow (const char *&p, const char *e)
+{
+  if (e - p < 3 || memcmp (p, "←", 3)) return false;
+  p += 3;
+  return true;
+}
+
+/***
+    An optional axis following a function or operator name.
+***/
+static bool
+scan_axis (const char *&p, const char *e)
+{
+  const char *q = p;
+  span_s x;
+  skip_space (q, e);
+  if (q >= e || *q != '[') return true;
+  q++;
+  skip_space (q, e);
+  if (!scan_name (q, e, x) || !scan_punct (q, e, ']')) return false;
+  p = q;
+  return true;
+}
+
+typedef enum {
+  ITEM_NAME,		// A, B, or a niladic/monadic/dyadic F
+  ITEM_OPT,		// {A}
+  ITEM_FUN		// F[X] or (LO OP RO), can only be the function
+} item_e;
+
+/***
+    One item of the header body.  For ITEM_FUN the span is the function
+    or operator name.
+***/
+static bool
+scan_item (const char *&p, const char *e, span_s &nm, item_e &kind)
+{
+  if (p >= e) return false;
+  if (*p == '{') {
+    p++;
+    skip_space (p, e);
+    if (!scan_name (p, e, nm) || !scan_punct (p, e, '}')) return false;
+    kind = ITEM_OPT;
+    return true;
+  }
+  if (*p == '(') {
+    span_s lo, ro;
+    p++;
+    skip_space (p, e);
+    if (!scan_name (p, e, lo)) return false;
+    skip_space (p, e);
+    if (!scan_name (p, e, nm) || !scan_axis (p, e)) return false;
+    skip_space (p, e);
+    if (p < e && *p != ')' && !scan_name (p, e, ro)) return false;
+    if (!scan_punct (p, e, ')')) return false;
+    kind = ITEM_FUN;
+    return true;
+  }
+  if (!scan_name (p, e, nm)) return false;
+  const char *q = p;
+  if (!scan_axis (p, e)) return false;
+  kind = (p == q) ? ITEM_NAME : ITEM_FUN;
+  return true;
+}
+
 static string
-parse_header (UTF8_string base_name, string &locals)
+parse_header (const UTF8_string &base_name, string &locals)
 {
-  cmatch m;
-  string fcn ;
-  if (regex_match (base_name.c_str (), m, niladic)) {
-    size_t len = m[3].second - m[3].first;
-    string tgt (m[3].first);
-    fcn = tgt.substr (0, len);
-    len = m[4].second - m[4].first;
-    string ltgt (m[4].first);
-    locals = ltgt.substr (0, len);
+  const char *p = base_name.c_str ();
+  const char *e = p + base_name.size ();
+  span_s items[3];
+  item_e kinds[3];
+  int ct = 0;
+
+  skip_space (p, e);
+  {						// R← or {R}←
+    const char *q = p;
+    span_s r;
+    item_e k;
+    if (scan_item (q, e, r, k) && k != ITEM_FUN) {
+      skip_space (q, e);
+      if (scan_arrow (q, e)) {
+	p = q;
+	skip_space (p, e);
+      }
+    }
   }
-  else if (regex_match (base_name.c_str (), m, monadic)) {
-    size_t len = m[3].second - m[3].first;
-    string tgt (m[3].first);
-    fcn = tgt.substr (0, len);
+
+  while (ct < 3 && scan_item (p, e, items[ct], kinds[ct])) {
+    ct++;
+    skip_space (p, e);
+  }
+  if (p < e && *p != ';') return string ();
+
+  int fx;
+  switch (ct) {
+  case 1: fx = 0; break;			// F
+  case 2: fx = 0; break;			// F B
+  case 3: fx = 1; break;			// A F B
+  default: return string ();
   }
-  else if (regex_match (base_name.c_str (), m, dyadic)) {
-    size_t len = m[4].second - m[4].first;
-    string tgt (m[4].first);
-    fcn = tgt.substr (0, len);
+  loop (i, ct) {
+    if (kinds[i] == ITEM_OPT && !(ct == 3 && i == 0)) return string ();
+    if (kinds[i] == ITEM_FUN && i != fx) return string ();
   }
-  return fcn;
+
+  locals.assign (p, e - p);
+  return string (items[fx].b, items[fx].n);
 }
 
+/***
+    Run edif on fn and wait for it to finish, as system() did, but
+    without a shell unless the command needs one.
+***/
+
+static void
+run_editor (const char *edif, const char *fn, reg_entry_s &re)
+{
+  /***
+      What system() did while it waited: a ^C meant for a terminal
+      editor must not interrupt APL too, and no SIGCHLD handler should
+      reap the editor first.
+  ***/
+  struct sigaction ign, old_int, old_quit;
+  ign.sa_handler = SIG_IGN;
+  sigemptyset (&ign.sa_mask);
+  ign.sa_flags = 0;
+  sigaction (SIGINT,  &ign, &old_int);
+  sigaction (SIGQUIT, &ign, &old_quit);
+  sigset_t chld, old_mask;
+  sigemptyset (&chld);
+  sigaddset (&chld, SIGCHLD);
+  sigprocmask (SIG_BLOCK, &chld, &old_mask);
+
+  vector<string> files (1, fn);
+  pid_t pid;
+  if (spawn_editor (edif, files, &pid, -1) != 0) perror ("edif editor");
+  else {
+    re.editor = pid;
+    int wstatus;
+    while (waitpid (pid, &wstatus, 0) == -1 && errno == EINTR) ;
+  }
+
+  sigaction (SIGINT,  &old_int,  NULL);
+  sigaction (SIGQUIT, &old_quit, NULL);
+  sigprocmask (SIG_SETMASK, &old_mask, NULL);
+}
 
 static Token
 eval_EB (const char *edif, Value_P B, APL_Integer idx)
@@ -459,27 +611,14 @@ eval_EB (const char *edif, Value_P B, APL_Integer idx)
     case NC_UNUSED_USER_NAME & NC_case_mask:
       {
 	get_fcn (fn, ifn, base_name.c_str (), B, locals);
-	char *buf;
-	asprintf (&buf, "%s %s", edif, fn);
-	system (buf);
-	if (buf) {
-	  free (buf);
-	  buf = NULL;
-	}
+	run_editor (edif, fn, reg_note (ifn, fn, is_lambda, false));
 
-	ifstream tfile;
-	tfile.open (fn, ios::in);
+	mapped_file_s mf;
 	UCS_string ucs;
 	UCS_string lambda_ucs;
-	if (tfile.is_open ()) {
-	  string line;
-	  int cnt = 0;
-	  while (getline (tfile, line)) {
-	    ucs.append_UTF8 (line.c_str ());
-	    ucs.append(UNI_LF);
-	    if (cnt++ == 0) lambda_ucs.append_UTF8 (line.c_str ());
-	  }
-	  tfile.close ();
+	if (map_file (fn, mf)) {
+	  text_to_ucs (mf.data, mf.size, ucs, is_lambda ? &lambda_ucs : NULL);
+	  unmap_file (mf);
 	  if (is_lambda) {
 	    if (lambda_ucs.has_black ()) {
 	      int len = 0;
@@ -532,48 +671,32 @@ eval_EB (const char *edif, Value_P B, APL_Integer idx)
 	  is_lambda = false;
 	  return Token (TOK_APL_VALUE1, Z);
 	}
-	cleanup (dir, base_name, fn);
+	cleanup (ifn, fn);
       }
       break;
     case NC_VARIABLE & NC_case_mask:
       {
 	Shape shape;
 	bool is_char;
-	get_var (fn, base_name.c_str (), B, shape, is_char);
-
-	char *buf;
-	asprintf (&buf, "%s %s", edif, fn);
-	system (buf);
-	if (buf) {
-	  free (buf);
-	  buf = NULL;
-	}
+	bool nested;
+	get_var (fn, base_name.c_str (), B, shape, is_char, nested);
+
+	run_editor (edif, fn, reg_note (ifn, fn, false, true));
 	
-	ifstream tfile;
-	tfile.open (fn, ios::in);
-	if (tfile.is_open ()) {
-	  UCS_string ucs (ustr);
-	  ucs.append (UTF8_string ("←"));
-	  uRank rank = shape.get_rank ();
-	  if (rank > 0) {
-	    loop (r, rank) {
-	      ostringstream cval;
-	      cval << shape.get_shape_item (r);
-	      UTF8_string uuu (cval.str ().c_str ());
-	      ucs.append (uuu);
-	      ucs.append(UNI_SPACE);
-	    }
-	    ucs.append (UTF8_string ("⍴"));
-	  }
-	  if (is_char)ucs.append (UTF8_string ("'"));
-	  string line;
-	  while (getline (tfile, line)) {
-	    ucs.append_UTF8 (line.c_str ());
-	    ucs.append(UNI_SPACE);
+	mapped_file_s mf;
+	if (map_file (fn, mf)) {
+	  string text (mf.data, mf.size);
+	  unmap_file (mf);
+	  const char *err = nested ? assign_nested_text (ustr, text)
+	    : assign_text (ustr, text, is_char, shape);
+	  if (err) {
+	    UTF8_string err_utf (err);
+	    UCS_string ucs (err_utf);
+	    Value_P Z (ucs, LOC);
+	    Z->check_value (LOC);
+	    cleanup (ifn, fn);
+	    return Token (TOK_APL_VALUE1, Z);
 	  }
-	  if (is_char)ucs.append (UTF8_string ("'"));
-	  tfile.close ();
-	  Command::do_APL_expression (ucs);
 	}
 	else {
 	  UCS_string ucs (UTF8_string ("Error opening working file."));
@@ -581,7 +704,7 @@ eval_EB (const char *edif, Value_P B, APL_Integer idx)
 	  Z->check_value (LOC);
 	  return Token (TOK_APL_VALUE1, Z);
 	}
-	cleanup (dir, base_name, fn);
+	cleanup (ifn, fn);
       }
       break;
     default:
@@ -19,13 +19,12 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#define USE_KIDS
-
+#include <errno.h>
 #include <error.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <limits.h>
 #include <malloc.h>
-#include <mqueue.h>
 #include <pthread.h>
 #include <poll.h>
 #include <signal.h>
@@ -33,21 +32,35 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 
+#include<algorithm>
+#include<atomic>
+#include<map>
 #include<iostream>
 #include<fstream>
 #include<string>
+#include<unordered_map>
+#include<unordered_set>
+#include<vector>
 
 #include "Macro.hh"
 #include "Command.hh"
 
 #include "edif2.hh"
+#include "edif_var.hh"
+#include "edif_spawn.hh"
+#include "edif_read.hh"
+#include "edif_text.hh"
+#include "edif_history.hh"
+#include "edif_registry.hh"
 #include "gitversion.h"
 
 #ifdef HAVE_CONFIG_H
@@ -67,43 +80,472 @@
 #endif
 
 
-//#define DO_DEBUG
-//#define DO_DEBUG2
-
-#if defined (DO_DEBUG) || defined (DO_DEBUG2)
-ofstream logfile ("/tmp/edif2.log");
-#endif
-
-static pthread_mutex_t *mutex;
-static pthread_mutexattr_t mutexattr;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 //static char *shared_block;
 
 #define APL_SUFFIX ".apl"
 #define LAMBDA_PREFIX "_lambda_"
-#define MQ_SIGNAL (SIGRTMAX - 2)
-static char *mq_name = NULL;
+#define VAR_PREFIX "_var_"
 
 using namespace std;
 
-static pid_t watch_pid = -1;
-#ifdef USE_KIDS
-static pid_t *kids = NULL;
-static int kids_nxt = 0;
-static int kids_max = 0;
-#define KIDS_INCR 8
-#else
-static pid_t group_pid = 0;
+/***
+    The watcher runs as a thread inside the APL process.  It sleeps in
+    epoll_wait() on the inotify descriptor and on stop_fd, an eventfd
+    stop_session() uses to tell it to quit.  Names of saved files go into
+    ring, a single-producer/single-consumer queue: the watcher thread
+    only ever advances ring_head, the interpreter thread only ever
+    advances ring_tail.
+
+    Nothing is fixed when a file is saved.  The ring is drained at safe
+    points only -- at the top of every edif2 call and on edif2 [6] --
+    and always on the interpreter's own thread.  The watcher never
+    signals the interpreter: GNU APL has no hook for running code while
+    it waits at the prompt, and a signal handler is no place to fix a
+    function.
+***/
+static pthread_t watch_thread;
+static bool watch_running = false;
+static atomic<bool> stop_flush (false);	// hand off what is pending on stop
+static int inotify_fd = -1;
+static int epoll_fd   = -1;
+static int stop_fd    = -1;
+
+#define RING_SLOTS 256			// must be a power of two
+typedef struct {
+  int      wd;				// which directory
+  uint64_t seen;				// first event for the name
+  uint64_t queued;			// now_ns() at hand_off()
+  char     name[NAME_MAX + 1];
+} ring_slot_s;
+static ring_slot_s ring[RING_SLOTS];
+static atomic<uint32_t> ring_head (0);
+static atomic<uint32_t> ring_tail (0);
+static bool draining = false;
+
+/***
+    Set by the watcher when it knows it has lost events, either because
+    the kernel queue overflowed or because the ring was full.  The next
+    drain then rescans dir against file_index instead.
+***/
+static atomic<bool> rescan_needed (false);
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
 #endif
 
 /***
-    alloced in get_signature
-    freed in close_fun
+    Every editor process edif2 starts, servers and the emacsclient or
+    nvim --remote calls that talk to them included.  Each one's pidfd
+    sits in the watcher's epoll set; when it turns readable the editor
+    has exited and the watcher reaps it with a WNOHANG waitpid(), so
+    nothing ever waits in a signal handler.  Where pidfd_open() fails,
+    the entry gets pidfd -1 and the watcher polls it every POLL_MS
+    instead.  The table is shared with the watcher, so only touch it
+    holding editors_mutex; live_editors can be read without.
+***/
+typedef struct {
+  pid_t    pid;
+  int      pidfd;
+  uint64_t started;			// now_ns()
+  string   files;			// blank separated
+} editor_s;
+static unordered_map<pid_t, editor_s> editors;
+static pthread_mutex_t editors_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic<int> live_editors (0);
+static atomic<int> polled_editors (0);	// those with no pidfd
+static vector<pid_t> orphans;		// killed, not yet reaped
+#define POLL_MS 250
+
+/***
+    The same pids again, for edit_eval_handler(), which can neither
+    take editors_mutex nor walk an unordered_map.  A slot is claimed
+    with a compare-and-swap from 0; more editors than slots are still
+    supervised, just not killed on a signal.
+***/
+#define EDITOR_SLOTS 64
+static atomic<pid_t> editor_slots[EDITOR_SLOTS];
+static volatile sig_atomic_t session_killed = 0;
+
+static void
+slot_claim (pid_t pid)
+{
+  loop (i, EDITOR_SLOTS) {
+    pid_t none = 0;
+    if (editor_slots[i].compare_exchange_strong (none, pid)) return;
+  }
+}
+
+static void
+slot_release (pid_t pid)
+{
+  loop (i, EDITOR_SLOTS) {
+    pid_t was = pid;
+    if (editor_slots[i].compare_exchange_strong (was, 0)) return;
+  }
+}
+
+/***
+    Nothing above exists until the first edit.  ⎕fx only records the
+    default editor; start_session() creates dir, the watcher and the
+    signal handlers when an editor is actually launched, and
+    stop_session() takes the watcher and handlers down again at the
+    first safe point after the last editor has exited.  dir, which edif
+    shares, stays until close_fun().  Editors that fork themselves into
+    the background (gvim without -f) therefore end the session early.
+***/
+static bool session_busy = false;
+static int dir_wd = -1;			// dir's inotify watch
+
+/***
+    Mirror mode, edif2 [9] '/some/tree': a source tree watched
+    recursively alongside dir.  Every .apl file in it is loaded on
+    attach, and after that only files whose text has changed are fixed
+    again, through the same check_file() and read_file() as edited
+    files.  mirror_dirs maps each inotify watch to its directory; the
+    watcher adds to it as directories appear, so it has its own lock.
+    mirror_gen moves on at every attach and detach; a watcher still
+    walking a tree from before then drops what it adds rather than
+    leaking it.  While a tree is attached the session stays up.  A
+    batch of more than MIRROR_BULK changed files is not handed over
+    name by name, which could fill the ring many times over, but as a
+    single rescan.
+***/
+#define MIRROR_MASK \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)
+#define MIRROR_BULK (RING_SLOTS / 4)
+static pthread_mutex_t mirror_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unordered_map<int, string> mirror_dirs;
+static string mirror_root;
+static unsigned mirror_gen = 0;		// under mirror_mutex
+static volatile sig_atomic_t mirror_attached = 0;
+
+/***
+    Server mode keeps one editor running for the whole session and
+    hands it each new set of files through its client instead of
+    starting a fresh editor every time.  The server is the first editor
+    launched, told to listen on SERVER_SOCKET in dir; it is an ordinary
+    entry in editors, so it keeps the session alive, and it is started again the
+    next time round if it has died.  Set by EDIF2_SERVER or edif2 [7].
+***/
+typedef enum {
+  SERVER_NONE,
+  SERVER_EMACS,
+  SERVER_NVIM,
+  SERVER_COUNT
+} server_e;
+static const char *server_names[SERVER_COUNT] = { "none", "emacs", "nvim" };
+static server_e server_mode = SERVER_NONE;
+static server_e server_kind = SERVER_NONE;	// what server_pid runs
+static atomic<pid_t> server_pid (0);
+#define SERVER_SOCKET "edif2.sock"
+static const int session_sigs[] =
+  { SIGABRT, SIGHUP, SIGINT, SIGQUIT, SIGTSTP, SIGSEGV };
+#define SESSION_SIG_COUNT (sizeof(session_sigs) / sizeof(*session_sigs))
+static struct sigaction session_old[SESSION_SIG_COUNT];
+static bool session_sigs_set = false;
+
+/***
+    alloced in start_session
+    freed in stop_session
 ***/
 static char *dir = NULL;
 
-static mqd_t mqd = -1;
 static bool is_lambda;
 static bool force_lambda = false;
+
+/***
+    What we know about each file in dir, keyed by the fully qualified
+    file name: the stat() signature of the last version we looked at
+    and a hash of the last text that was fixed (or written out by
+    get_fcn(), which is what's in the workspace at the time).
+    handle_msg() uses this to avoid re-fixing text that hasn't changed.
+***/
+typedef struct {
+  time_t   tv_sec;
+  long     tv_nsec;
+  off_t    size;
+  uint64_t hash;
+} file_state_s;
+
+static unordered_map<string, file_state_s> file_index;
+
+/***
+    Shape and type of each variable being edited, keyed by name, so the
+    edited text can be read back the way it was written.
+***/
+typedef struct {
+  Shape shape;
+  bool is_char;
+  bool nested;		// written by write_nested()
+} var_state_s;
+
+static unordered_map<string, var_state_s> var_index;
+
+/***
+    Opening a big function costs mostly canonical() and the rendering,
+    and check_file() renders it again on every save, so the text and
+    its hash are kept, keyed by the function object.  A fix always
+    makes a new UserFunction, and its creation time tells it from an
+    old one that happened to have the same address; macros never
+    change.  Past RENDER_CACHE_MAX functions the cache starts over.
+***/
+typedef struct {
+  APL_Integer created;
+  bool        lambda;
+  string      base;
+  string      text;
+  uint64_t    hash;
+} render_s;
+static unordered_map<const Function *, render_s> render_cache;
+#define RENDER_CACHE_MAX 256
+
+/***
+    Counters returned by edif2 [4].
+***/
+enum {
+  CNT_EVENTS,		// files reported by the watcher
+  CNT_FIXES,		// files actually fixed
+  CNT_STAT_SKIPS,	// skipped, mtime and size unchanged
+  CNT_HASH_SKIPS,	// skipped, same text as the last fix
+  CNT_CANON_SKIPS,	// skipped, same text as the workspace definition
+  CNT_INOTIFY,		// raw inotify events seen by the watcher
+  CNT_MERGED,		// events folded into one already pending
+  CNT_DROPPED,		// names lost to a full ring
+  CNT_RESCANS,		// directory rescans after lost events
+  CNT_FAILED,		// fixes or assignments that failed
+  CNT_COUNT
+};
+static const char *counter_names[CNT_COUNT] =
+  { "events", "fixes", "stat skips", "hash skips", "canon skips",
+    "inotify", "merged", "dropped", "rescans", "failed" };
+static atomic<APL_Integer> counters[CNT_COUNT];
+
+/***
+    Where the time goes, for edif2 [12].  Each stage keeps a count, a
+    total, a maximum, a histogram of log2 microseconds -- bucket 0 is
+    under a microsecond, bucket b under 2^b, and the last bucket takes
+    everything longer -- and its last STG_SAMPLES times, which the
+    percentiles come from.  Relaxed atomic adds and stores and one
+    clock_gettime() per end, so they stay on.
+***/
+enum {
+  STG_LOOKUP,		// real_get_fcn()
+  STG_RENDER,		// canonical() and writing the working file
+  STG_SPAWN,		// starting an editor
+  STG_DELIVER,		// inotify event to the ring, debounce included
+  STG_QUEUE,		// waiting in the ring for the interpreter
+  STG_DISPATCH,		// handle_msg(), all of it
+  STG_DECODE,		// read_file() turning UTF-8 into a UCS_string
+  STG_FIX,		// UserFunction::fix(), or reassigning a variable
+  STG_SAVE,		// first event for a file to its fix, end to end
+  STG_COUNT
+};
+static const char *stage_names[STG_COUNT] =
+  { "lookup", "render", "spawn", "deliver", "queue", "dispatch",
+    "decode", "fix", "save" };
+#define STG_BUCKETS 24
+#define STG_SAMPLES 4096		// must be a power of two
+typedef struct {
+  atomic<APL_Integer> count;
+  atomic<APL_Integer> total_ns;
+  atomic<APL_Integer> max_ns;
+  atomic<APL_Integer> hist[STG_BUCKETS];
+  atomic<APL_Integer> samples[STG_SAMPLES];	// ns, by count
+} stage_s;
+static stage_s stages[STG_COUNT];
+
+static uint64_t
+now_ns ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+stage_note (int stg, uint64_t start)
+{
+  uint64_t end = now_ns ();
+  APL_Integer ns = (end > start) ? end - start : 0;
+  stage_s &st = stages[stg];
+  APL_Integer n = st.count.fetch_add (1, memory_order_relaxed);
+  st.samples[n & (STG_SAMPLES - 1)].store (ns, memory_order_relaxed);
+  st.total_ns.fetch_add (ns, memory_order_relaxed);
+  APL_Integer max = st.max_ns.load (memory_order_relaxed);
+  while (ns > max &&
+	 !st.max_ns.compare_exchange_weak (max, ns, memory_order_relaxed));
+  uint64_t us = ns / 1000;
+  int b = us ? 64 - __builtin_clzll (us) : 0;
+  if (b >= STG_BUCKETS) b = STG_BUCKETS - 1;
+  st.hist[b].fetch_add (1, memory_order_relaxed);
+}
+
+/***
+    The time in microseconds below which frac of a stage's runs fell,
+    exactly, over its last STG_SAMPLES runs: the nearest-rank value of
+    the samples, not a bucket bound.  A run still being noted may show
+    up as the run it replaces.
+***/
+
+static APL_Integer
+stage_percentile (const stage_s &st, double frac)
+{
+  APL_Integer cnt = min (st.count.load (), (APL_Integer)STG_SAMPLES);
+  if (cnt == 0) return 0;
+  vector<APL_Integer> ns (cnt);
+  loop (i, cnt) ns[i] = st.samples[i].load (memory_order_relaxed);
+  APL_Integer rank = (APL_Integer)(frac * cnt + 0.999999);
+  if (rank < 1) rank = 1;
+  if (rank > cnt) rank = cnt;
+  nth_element (ns.begin (), ns.begin () + rank - 1, ns.end ());
+  return ns[rank - 1] / 1000;
+}
+
+/***
+    edif2 [14]: start counting afresh, e.g. before a run to be measured.
+***/
+
+static void
+metrics_reset ()
+{
+  loop (c, CNT_COUNT) counters[c] = 0;
+  loop (g, STG_COUNT) {
+    stage_s &st = stages[g];
+    st.count = 0;
+    st.total_ns = 0;
+    st.max_ns = 0;
+    loop (b, STG_BUCKETS) st.hist[b] = 0;
+    loop (i, STG_SAMPLES) st.samples[i] = 0;
+  }
+}
+
+/***
+    The trace: the last TRACE_SLOTS things that happened to edits, in
+    memory, always on.  Both threads write it.  A writer claims a
+    sequence number with one fetch_add, so writers never wait for each
+    other, and marks its slot with that number, plus one, once the
+    record is complete; a reader copies a slot and keeps the copy only
+    if the mark was the same before and after.  edif2 [13] returns it
+    or writes it out, and a failed fix writes it to trace_path, so a
+    slow or lost save can be looked into after the fact.
+***/
+enum {
+  TR_SPAWN,		// arg: pid, name: first file
+  TR_EXIT,		// arg: pid of an editor reaped
+  TR_EVENT,		// arg: wd, from inotify
+  TR_SEND,		// arg: wd, into the ring
+  TR_DROP,		// arg: wd, ring full
+  TR_RECV,		// arg: wd, out of the ring
+  TR_READ,		// arg: bytes read
+  TR_SKIP,		// arg: 1 stat, 2 hash, 3 same as the workspace
+  TR_FIX,		// arg: 1 fixed, 0 failed
+  TR_ERASE,		// a lambda erased before it is redefined
+  TR_COUNT
+};
+static const char *trace_names[TR_COUNT] =
+  { "spawn", "exit", "event", "send", "drop", "recv", "read", "skip",
+    "fix", "erase" };
+#define TRACE_SLOTS 4096		// must be a power of two
+#define TRACE_NAME  40
+typedef struct {
+  atomic<uint64_t> mark;		// sequence + 1 when complete
+  uint64_t ns;
+  int32_t  kind;
+  int32_t  arg;
+  char     name[TRACE_NAME];
+} trace_rec_s;
+typedef struct {
+  uint64_t seq;
+  uint64_t ns;
+  int32_t  kind;
+  int32_t  arg;
+  char     name[TRACE_NAME];
+} trace_copy_s;
+static trace_rec_s trace_ring[TRACE_SLOTS];
+static atomic<uint64_t> trace_next (0);
+static char *trace_path = NULL;		// EDIF2_TRACE
+
+static void
+trace (int kind, int arg, const char *name)
+{
+  uint64_t seq = trace_next.fetch_add (1, memory_order_relaxed);
+  trace_rec_s &r = trace_ring[seq & (TRACE_SLOTS - 1)];
+  r.mark.store (0, memory_order_relaxed);
+  atomic_thread_fence (memory_order_release);
+  r.ns   = now_ns ();
+  r.kind = kind;
+  r.arg  = arg;
+  const char *slash = name ? strrchr (name, '/') : NULL;
+  strncpy (r.name, slash ? slash + 1 : name ? name : "", TRACE_NAME - 1);
+  r.name[TRACE_NAME - 1] = 0;
+  r.mark.store (seq + 1, memory_order_release);
+}
+
+static vector<trace_copy_s>
+trace_snapshot ()
+{
+  vector<trace_copy_s> recs;
+  uint64_t next = trace_next.load (memory_order_acquire);
+  uint64_t first = (next > TRACE_SLOTS) ? next - TRACE_SLOTS : 0;
+  recs.reserve (next - first);
+  for (uint64_t seq = first; seq < next; seq++) {
+    trace_rec_s &r = trace_ring[seq & (TRACE_SLOTS - 1)];
+    if (r.mark.load (memory_order_acquire) != seq + 1) continue;
+    trace_copy_s c;
+    c.seq  = seq;
+    c.ns   = r.ns;
+    c.kind = r.kind;
+    c.arg  = r.arg;
+    memcpy (c.name, r.name, TRACE_NAME);
+    c.name[TRACE_NAME - 1] = 0;
+    atomic_thread_fence (memory_order_acquire);
+    if (r.mark.load (memory_order_relaxed) != seq + 1) continue;
+    if (c.kind < 0 || c.kind >= TR_COUNT) continue;
+    recs.push_back (c);
+  }
+  return recs;
+}
+
+/***
+    One line per record: seconds since the oldest, what, arg, name.
+    Returns the number of records written, or -1.  With no path it goes
+    to /var/run/user/<uid>, which only the user can write to, not to a
+    name in /tmp that anyone could have put a symbolic link at first.
+***/
+
+static APL_Integer
+trace_dump (const char *path)
+{
+  char *def = NULL;
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  if (!path || !*path) {
+    asprintf (&def, "/var/run/user/%d/edif2.%d.trace",
+	      (int)getuid (), (int)getpid ());
+    path = def;
+    flags |= O_NOFOLLOW;
+  }
+  if (!path) return -1;
+  int fd = open (path, flags, 0600);
+  if (def) free (def);
+  if (fd == -1) return -1;
+  vector<trace_copy_s> recs = trace_snapshot ();
+  uint64_t base = recs.empty () ? 0 : recs.front ().ns;
+  for (const trace_copy_s &c : recs)
+    dprintf (fd, "%12.6f %-6s %8d %s\n", (double)(c.ns - base) / 1e9,
+	     trace_names[c.kind], (int)c.arg, c.name);
+  close (fd);
+  return recs.size ();
+}
+
+/***
+    Editors tend to save in bursts -- backup file, swap file, the file
+    itself, sometimes more than once.  The watcher holds each name back
+    until no event for it has arrived for debounce_ms milliseconds, so a
+    burst becomes a single fix.  Set by EDIF2_DEBOUNCE or edif2 [5].
+***/
+#define DEBOUNCE_DEFAULT 20
+static atomic<long> debounce_ms (DEBOUNCE_DEFAULT);
 static const UCS_string WHITESPACE = UTF8_string (" \n\t\r\f\v");
 
 #define EDIF2_DEFAULT \
@@ -172,23 +614,13 @@ notify_start ()
 
 #endif
 
-#ifdef USE_KIDS
-static void
-add_a_kid (pid_t kid)
-{
-  if (kids_max <= kids_nxt) {
-    kids_max += KIDS_INCR;
-    kids = (pid_t *)realloc (kids, kids_max * sizeof(pid_t));
-  }
-  kids[kids_nxt++] = kid;
-}
-#endif
-
 const Function *
 real_get_fcn (UCS_string symbol_name)
 {
+  uint64_t start = now_ns ();
   const Function * function = 0;
-  while (symbol_name.back() <= ' ')   symbol_name.pop_back();
+  while (symbol_name.size() && symbol_name.back() <= ' ')
+    symbol_name.pop_back();
   if (symbol_name.size() != 0) {
     if (symbol_name[0] == UNI_MUE) {   // macro
       loop (m, Macro::MAC_COUNT) {
@@ -209,71 +641,41 @@ real_get_fcn (UCS_string symbol_name)
       }
     }
   }
+  stage_note (STG_LOOKUP, start);
   return function;
 }
 
+static void stop_session (bool apply);
+static void reap_orphans (int wait_ms = 0);
+
 static bool
 close_fun (Cause cause, const NativeFunction * caller)
 {
-  pthread_mutex_lock (mutex);
-  if (dir) {
-    DIR *path;
-    struct dirent *ent;
-    if ((path = opendir (dir)) != NULL) {
-      while ((ent = readdir (path)) != NULL) {
-	char *lfn;
-	asprintf (&lfn, "%s/%s", dir, ent->d_name);
-	unlink (lfn);
-	free (lfn);
-      }
-      closedir (path);
-    } 
+  pthread_mutex_lock (&editors_mutex);
+  for (auto &e : editors) kill (e.first, SIGTERM);	// server too
+  pthread_mutex_unlock (&editors_mutex);
+  server_pid = 0;
+
+  stop_session (false);
+  reap_orphans (500);
 
-    rmdir (dir);
+  pthread_mutex_lock (&mutex);
+  if (dir) {
+    reg_clear (dir);
     free (dir);
     dir = NULL;
   }
-  pthread_mutex_unlock (mutex);
-
-  pthread_mutex_lock (mutex);
-  if (mqd != -1) {
-    mq_close (mqd);
-    mqd = -1;
-  }
-  pthread_mutex_unlock (mutex);
-
-  pthread_mutex_lock (mutex);
-  if (mq_name) {
-    mq_unlink (mq_name);
-    free (mq_name);
-    mq_name = NULL;
-  }
-  pthread_mutex_unlock (mutex);
-
-
-#ifdef USE_KIDS
-  int i;
-  for (i = 0; i < kids_nxt; i++) {
-    if (kids[i] > 0) kill (kids[i], SIGTERM);
-  }
-#else
-  if (group_pid > 0) {
-    killpg (group_pid, SIGTERM);
-    group_pid = 0;
-  }
-#endif
-
-  if (watch_pid > 0) {
-    kill (watch_pid, SIGTERM);
-    watch_pid = 0;
-  }
-  
-  pthread_mutex_lock (mutex);
   if (edif2_default) {
     free (edif2_default);
     edif2_default = NULL;
   }
-  pthread_mutex_unlock (mutex);
+  if (trace_path) {
+    free (trace_path);
+    trace_path = NULL;
+  }
+  hist_clear ();
+  render_cache.clear ();
+  pthread_mutex_unlock (&mutex);
   return false;
 }
 
@@ -282,25 +684,24 @@ close_fun (Cause cause, const NativeFunction * caller)
     fn = fully qualified file name
 ***/
 
-static void
-read_file (const char *base_name, const char *fn)
+/***
+    Returns false if the text would not fix.
+***/
+
+static bool
+read_file (const char *base_name, const string &text)
 {
-  if (*base_name == '.') return;
-  ifstream tfile;
-  tfile.open (fn, ios::in);
+  bool ok = true;
+  if (*base_name == '.') return ok;
   UCS_string ucs;
   UCS_string lambda_ucs;
-  if (tfile.is_open ()) {
-    string line;
+  if (!text.empty ()) {
     bool is_lambda_local =
       (0 == strncmp (base_name, LAMBDA_PREFIX, strlen (LAMBDA_PREFIX)));
-    int cnt = 0;
-    while (getline (tfile, line)) {
-      ucs.append_UTF8 (line.c_str ());
-      ucs.append(UNI_LF);
-      if (cnt++ == 0) lambda_ucs.append_UTF8 (line.c_str ());
-    }
-    tfile.close ();
+    uint64_t start = now_ns ();
+    text_to_ucs (text.data (), text.size (), ucs,
+		 is_lambda_local ? &lambda_ucs : NULL);
+    stage_note (STG_DECODE, start);
     if (is_lambda_local) {
       if (lambda_ucs.has_black ()) {
 	if (lambda_ucs.back () != L'←') {
@@ -328,10 +729,14 @@ read_file (const char *base_name, const char *fn)
 	  if (function != NULL) {
 	    UCS_string erase_cmd(UTF8_string (")ERASE "));
 	    erase_cmd.append (target_name);
+	    trace (TR_ERASE, 0, base_name);
 	    Bif_F1_EXECUTE::execute_command(erase_cmd);
 	  }
 
+	  uint64_t start = now_ns ();
 	  Command::do_APL_expression (lambda_ucs);
+	  stage_note (STG_FIX, start);
+	  ok = (NULL != real_get_fcn (target_name));
 	}
       }
     }
@@ -345,309 +750,1604 @@ read_file (const char *base_name, const char *fn)
 	UCS_string creator (UTF8_string (base_name));
 	UTF8_string creator_utf8(creator);
 #endif
-	UserFunction::fix (ucs,			// text
-			   error_line,		// err_line
-			   false,		// keep_existing
-			   LOC,			// loc
-			   creator_utf8,	// creator
-			   true);		// tolerant
+	uint64_t start = now_ns ();
+	ok = (NULL != UserFunction::fix (ucs,		// text
+					 error_line,	// err_line
+					 false,		// keep_existing
+					 LOC,		// loc
+					 creator_utf8,	// creator
+					 true));	// tolerant
+	stage_note (STG_FIX, start);
       }
     }
   }
+  return ok;
 }
 
+/***
+    Reassign an edited variable.  The text is parsed straight into a
+    Value; see edif_var.hh.
+***/
 
 static bool
-enable_mq_notify ()
+read_var (const char *base_name, const string &text)
 {
-  union sigval sv;
-  sv.sival_int = 0;
-  struct sigevent sevp;
-  sevp.sigev_notify = SIGEV_SIGNAL;
-  sevp.sigev_value  = sv;
-  sevp.sigev_signo  = MQ_SIGNAL;
-  int rc = mq_notify (mqd, &sevp);
-  return (rc == -1) ? false : true;
+  auto it = var_index.find (base_name);
+  if (it == var_index.end ()) return false;
+  UTF8_string base_utf (base_name);
+  UCS_string name (base_utf);
+  const char *err = it->second.nested ? assign_nested_text (name, text)
+    : assign_text (name, text, it->second.is_char, it->second.shape);
+  if (err) cerr << base_name << ": " << err << endl;
+  return !err;
 }
 
-typedef struct {
-  pid_t pid;
-  time_t tv_sec;
-  long   tv_nsec;
-} ts_s;
 
-ts_s last_time = {0, 0, 0};
+static bool
+slurp (const char *fn, string &text, struct stat &sb)
+{
+  int fd = open (fn, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  bool rc = false;
+  if (0 == fstat (fd, &sb)) {
+    text.resize (sb.st_size);
+    size_t got = 0;
+    while (got < text.size ()) {
+      ssize_t sz = read (fd, &text[got], text.size () - got);
+      if (sz < 0 && errno == EINTR) continue;
+      if (sz <= 0) break;
+      got += sz;
+    }
+    text.resize (got);
+    rc = true;
+  }
+  close (fd);
+  return rc;
+}
+
+/***
+    The text get_fcn() writes for a function: the canonical form, or
+    name←{body} for lambdas.  Splitting it into lines needs GNU APL and
+    so the interpreter thread; the lines are then plain code points,
+    and render_lines() turns them into UTF-8 with nothing from APL,
+    which lets export_all() do that part on its workers.
+***/
 
 static void
-handle_msg ()
-{
-  char bfr[NAME_MAX + 8];
-  struct timespec ts = {.tv_sec = 0, .tv_nsec = 10000};
-  ssize_t sz;
-  while (0 <= (sz = mq_timedreceive(mqd, bfr, NAME_MAX + 8, NULL, &ts))) {
-    char *cpy = strdup (bfr);
-    if (cpy) {
-      char *suffix = &cpy[strlen (bfr) - strlen (APL_SUFFIX)];
-      if (!strcmp (suffix, APL_SUFFIX)) {
-	char *fn = NULL;
-	asprintf (&fn, "%s/%s", dir, bfr);
-	if (fn) {
-	  struct stat result;
-	  bool do_read = true;
-	  if (0 == stat (fn, &result)) {
-	    if (last_time.pid == 0 || last_time.pid == getpid ()) {
-	      do_read =
-		(result.st_mtim.tv_sec > last_time.tv_sec) ||
-		(result.st_mtim.tv_nsec > last_time.tv_nsec);
-	      last_time.pid = getpid ();
-	      last_time.tv_sec  = result.st_mtim.tv_sec;
-	      last_time.tv_nsec = result.st_mtim.tv_nsec;
-	    }
-	  }
-	  *suffix = 0;
-	  if (do_read) read_file (cpy, fn);
-	  free (fn);
-	}
+ucs_lines (const UCS_string &ucs, vector<u32string> &lines)
+{
+  UCS_string_vector tlines;
+  ucs.to_vector(tlines);
+  lines.resize (tlines.size ());
+  loop(row, tlines.size()) {
+    const UCS_string & line = tlines[row];
+    u32string &l = lines[row];
+    l.resize (line.size ());
+    loop(col, line.size()) l[col] = (char32_t)line[col];
+  }
+}
+
+static string
+render_lines (const vector<u32string> &lines, const string &base, bool lambda)
+{
+  string text;
+  loop(row, lines.size()) {
+    const u32string & line = lines[row];
+    if (lambda) {
+      if (row == 0) continue;		// skip header
+      else {
+	size_t skip = line.size () < 2 ? line.size () : 2;  // skip assignment
+	text += base;
+	text += "←{";
+	encode_utf8 (line.data () + skip, line.size () - skip, text);
+	text += "}\n";
+	break;
       }
-      free (cpy);
+    }
+    else {
+      encode_utf8 (line.data (), line.size (), text);
+      text += "\n";
     }
   }
-  
-  if (!enable_mq_notify ())
-    fprintf (stderr, "internal mq_notify error in edif2");
+  return text;
 }
 
+static APL_Integer
+creation_time (const Function *function)
+{
+  const UserFunction *ufun = function->get_func_ufun ();
+  return ufun ? ufun->get_creation_time () : 0;
+}
 
-static void
-watch_chld_handler(int sig, siginfo_t *si, void *data)
+/***
+    The cached rendering of function, or NULL if there is none or it is
+    out of date.
+***/
+
+static const render_s *
+render_find (const Function *function, const char *base, bool lambda)
 {
-  int wstatus;
-  while (0 < waitpid (si->si_pid, &wstatus, WNOHANG));
+  auto it = render_cache.find (function);
+  if (it != render_cache.end () &&
+      it->second.created == creation_time (function) &&
+      it->second.lambda == lambda && it->second.base == base)
+    return &it->second;
+  return NULL;
 }
 
+static const render_s &
+render_fcn (const Function *function, const char *base, bool lambda)
+{
+  const render_s *found = render_find (function, base, lambda);
+  if (found) return *found;
+  if (render_cache.find (function) == render_cache.end () &&
+      render_cache.size () >= RENDER_CACHE_MAX)
+    render_cache.clear ();
+  render_s &r = render_cache[function];
+  r.created = creation_time (function);
+  r.lambda  = lambda;
+  r.base    = base;
+  vector<u32string> lines;
+  ucs_lines (function->canonical(false), lines);
+  r.text    = render_lines (lines, r.base, lambda);
+  r.hash    = text_hash (r.text.data (), r.text.size ());
+  return r;
+}
 
 static void
-edit_chld_handler(int sig, siginfo_t *si, void *data)
+note_written (const char *fn, const string &text)
 {
-  int wstatus;
-#ifdef USE_KIDS
-  int i;
-#endif
-  waitpid (si->si_pid, &wstatus, 0 /* WNOHANG */);
-#ifdef USE_KIDS
-  for (i = 0; i < kids_nxt; i++) {if (kids[i] == si->si_pid) kids[i] = -1;}
-#endif
-  while (0 < waitpid (si->si_pid, &wstatus, WNOHANG)) {
-#ifdef USE_KIDS
-    for (i = 0; i < kids_nxt; i++) {if (kids[i] == si->si_pid) kids[i] = -1;}
-#endif
+  struct stat sb;
+  if (0 == stat (fn, &sb)) {
+    file_state_s &fs = file_index[fn];
+    fs.tv_sec  = sb.st_mtim.tv_sec;
+    fs.tv_nsec = sb.st_mtim.tv_nsec;
+    fs.size    = sb.st_size;
+    fs.hash    = text_hash (text.data (), text.size ());
   }
 }
 
+/***
+    For files streamed out without the text ever being in memory: only
+    the stat() signature is known, so the first save will be applied
+    even if it hasn't changed anything.
+***/
+
 static void
-msg_handler(int sig, siginfo_t *si, void *data)
+note_written (const char *fn)
 {
-  int wstatus;
-  waitpid (si->si_pid, &wstatus, WNOHANG);
-    //  while (0 < waitpid (si->si_pid, &wstatus, WNOHANG))
-    handle_msg ();
+  struct stat sb;
+  if (0 == stat (fn, &sb)) {
+    file_state_s &fs = file_index[fn];
+    fs.tv_sec  = sb.st_mtim.tv_sec;
+    fs.tv_nsec = sb.st_mtim.tv_nsec;
+    fs.size    = sb.st_size;
+    fs.hash    = 0;
+  }
 }
 
-Fun_signature
-get_signature()
+/***
+    Decide whether a saved file needs fixing.  Cheapest test first:
+    unchanged stat() signature, then the text of the last fix, then the
+    text the workspace definition would produce.  A text that failed to
+    fix leaves the last good hash alone, so saving it again, once
+    whatever stood in its way is gone, tries again.
+***/
+
+static void
+check_file (const char *base_name, const char *fn, uint64_t seen)
 {
-  if (mqd > 0) return SIG_Z_A_F2_B;	// already fixed
+  struct stat sb;
+  if (0 != stat (fn, &sb)) return;
+
+  auto it = file_index.find (fn);
+  if (it != file_index.end () &&
+      it->second.tv_sec  == sb.st_mtim.tv_sec &&
+      it->second.tv_nsec == sb.st_mtim.tv_nsec &&
+      it->second.size    == sb.st_size) {
+    counters[CNT_STAT_SKIPS]++;
+    trace (TR_SKIP, 1, base_name);
+    return;
+  }
 
-  mutex = (pthread_mutex_t *)mmap (NULL,
-				   sizeof(pthread_mutex_t),
-				   PROT_READ | PROT_WRITE,
-				   MAP_ANONYMOUS | MAP_SHARED, -1, 0);
-  pthread_mutexattr_init (&mutexattr);
-  pthread_mutexattr_setpshared (&mutexattr, PTHREAD_PROCESS_SHARED);
-  pthread_mutex_init (mutex, &mutexattr);
-  pthread_mutexattr_destroy (&mutexattr);
+  string text;
+  if (!slurp (fn, text, sb)) return;
+  trace (TR_READ, (int)text.size (), base_name);
+  uint64_t hash = text_hash (text.data (), text.size ());
+  file_state_s &fs = file_index[fn];
+  bool known = (it != file_index.end ());
+  fs.tv_sec  = sb.st_mtim.tv_sec;
+  fs.tv_nsec = sb.st_mtim.tv_nsec;
+  fs.size    = sb.st_size;
+  if (known && fs.hash == hash) {
+    counters[CNT_HASH_SKIPS]++;
+    trace (TR_SKIP, 2, base_name);
+    return;
+  }
 
-  asprintf (&dir, "/var/run/user/%d/%d",
-	    (int)getuid (), (int)getpid ());
-  mkdir (dir, 0700);
-  char *ed2 = getenv ("EDIF2");
-  
-  edif2_default = strdup (ed2 ?: EDIF2_DEFAULT);
-
-  struct sigaction msg_act;
-  msg_act.sa_sigaction = msg_handler;
-  sigemptyset (&msg_act.sa_mask);
-  msg_act.sa_flags = SA_SIGINFO | SA_RESTART;
-  sigaction (MQ_SIGNAL, &msg_act, NULL);
-
-  struct sigaction chld_act;
-  chld_act.sa_sigaction = watch_chld_handler;
-  sigemptyset (&chld_act.sa_mask);
-  chld_act.sa_flags = SA_SIGINFO | SA_RESTART;
-  sigaction (SIGCHLD, &chld_act, NULL);
-
-  struct mq_attr attr;
-  attr.mq_maxmsg  = 8;	// no good reason
-  attr.mq_msgsize = NAME_MAX + 1;
-  asprintf (&mq_name, "/APLEDIF_%d", (int)getpid ());
-  mq_unlink (mq_name);
-  mqd = mq_open (mq_name, O_RDWR | O_CREAT | O_NONBLOCK | O_EXCL,
-		 0600, &attr);
-  if (mqd == -1) {
-    perror ("internal mq_open error in edif2");
-    return SIG_NONE;
-  }
-
-  char bfr[NAME_MAX + 8];
-  struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000000};
-  ssize_t sz;
-  // empty the queue, just in case
-  while (0 < (sz = mq_timedreceive(mqd, bfr, NAME_MAX + 8, NULL, &ts))) {}
-  if (!enable_mq_notify ()) {
-    fprintf (stderr, "internal mq_notify error in edif2");
-    return SIG_NONE;
-  }
-
-#ifndef USE_KIDS
-  group_pid = getpid ();
-#endif
- 
-  pid_t pid = fork ();
-  if (pid > 0) watch_pid = pid;
-  else if (pid == 0) {		// child -- watch for file changes
-    
-    int inotify_fd = inotify_init ();
-    FILE *inotify_fp = fdopen(inotify_fd, "r");
-#ifdef CHLM_VERSION
-    int inotify_rc = inotify_add_watch (inotify_fd, dir,
-					IN_CREATE | IN_MODIFY);
-#else
-    // patch by Hans-Peter Sorge <hanspetersorge@netscape.net>
-    int inotify_rc = inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE); 
-#endif
-    // int inotify_rc = inotify_add_watch (inotify_fd, dir, IN_ALL_EVENTS);
-    while (1) {
-#define BUF_LEN (10 * (sizeof(struct inotify_event) + NAME_MAX + 1))
-      char buf[BUF_LEN] __attribute__ ((aligned(8)));
-      ssize_t sz = read (inotify_fd, buf, BUF_LEN);
-      if (sz < 0) clearerr (inotify_fp);
-      else {
-	struct inotify_event *event = (struct inotify_event *)buf;
-	if (event->len > 0 && strlen (event->name) > 0) {
-	resend:
-	  int mrc = mq_send (mqd, event->name, event->len, 0);
-	  if (mrc == -1) {
-	    if (errno == EINTR || errno == EAGAIN)
-	      goto resend;
-	    else perror ("internal mq_send error in edif2");
-	  }
-	}
-      }
+  bool variable =
+    (0 == strncmp (base_name, VAR_PREFIX, strlen (VAR_PREFIX)));
+  bool lambda =
+    (0 == strncmp (base_name, LAMBDA_PREFIX, strlen (LAMBDA_PREFIX)));
+  const char *name = variable ? base_name + strlen (VAR_PREFIX)
+    : lambda ? base_name + strlen (LAMBDA_PREFIX) : base_name;
+  reg_entry_s *re = reg_find (name);
+  if (re && re->path != fn) re = NULL;		// e.g. a mirrored file
+
+  if (variable) {
+    counters[CNT_FIXES]++;
+    uint64_t start = now_ns ();
+    bool ok = read_var (name, text);
+    stage_note (STG_FIX, start);
+    if (ok) fs.hash = hash;
+    if (ok && seen) stage_note (STG_SAVE, seen);
+    trace (TR_FIX, ok, base_name);
+    if (!ok) {
+      counters[CNT_FAILED]++;
+      trace_dump (trace_path);
     }
+    if (re) re->fix = ok ? FIX_OK : FIX_FAILED;
+    return;
   }
 
-  return SIG_Z_A_F2_B;
+  const Function *function = real_get_fcn (UCS_string (UTF8_string (name)));
+  if (function) {
+    if (render_fcn (function, name, lambda).hash == hash) {
+      fs.hash = hash;
+      counters[CNT_CANON_SKIPS]++;
+      trace (TR_SKIP, 3, base_name);
+      if (re) re->fix = FIX_UNCHANGED;
+      return;
+    }
+  }
+
+  counters[CNT_FIXES]++;
+  bool ok = read_file (base_name, text);
+  if (ok) {
+    fs.hash = hash;
+    hist_note (name, text, lambda);
+  }
+  if (ok && seen) stage_note (STG_SAVE, seen);
+  trace (TR_FIX, ok, base_name);
+  if (!ok) {
+    counters[CNT_FAILED]++;
+    trace_dump (trace_path);
+  }
+  if (re) re->fix = ok ? FIX_OK : FIX_FAILED;
 }
 
-// export EDIF2="emacs --geometry=80x60 -background '#ffffcc' -font 'DejaVu Sans Mono-10'"
+/***
+    False for _lambda_.apl, _var_.apl and the like, whose name would be
+    empty once the prefix is off.
+***/
 
-static char *
-get_fcn (const char *fn, const char *base, Value_P B)
+static bool
+names_something (const char *base_name)
 {
-  char *mfn = NULL;
-  UCS_string symbol_name(*B.get());
-  const Function * function = real_get_fcn (symbol_name);
-  if (function != 0) {
-    is_lambda = force_lambda || function->is_lambda();
-    if (is_lambda)
-      asprintf (&mfn, "%s/%s%s%s", dir, LAMBDA_PREFIX, base, APL_SUFFIX);
-    else
-      asprintf (&mfn, "%s/%s%s", dir, base, APL_SUFFIX);
-    
-    if (mfn) {				// freed in eval_EB
-      const UCS_string ucs = function->canonical(false);
-      UCS_string_vector tlines;
-      ucs.to_vector(tlines);
-      ofstream tfile;
-      tfile.open (mfn, ios::out);
-      loop(row, tlines.size()) {
-	const UCS_string & line = tlines[row];
-	UTF8_string utf (line);
-	if (is_lambda) {
-	  if (row == 0) continue;		// skip header
-	  else {
-	    utf = UCS_string (utf, 2, string::npos);	// skip assignment
-	     tfile << base << "←{" << utf << "}\n";
-	     break;
-	  }
-	}
-	else tfile << utf << endl;
-      }
-      tfile.flush ();
-      tfile.close ();
-    }
-  }
-  else {			// new fcn
-    if (force_lambda)
-      asprintf (&mfn, "%s/%s%s%s", dir, LAMBDA_PREFIX, base, APL_SUFFIX);
-    else
-      mfn = strdup (fn);		// freed in eval_EB
-    if (mfn) {
-      ofstream tfile;
-      tfile.open (mfn, ios::out);
-      if (force_lambda)
-	tfile << base << "←";
-      else
-	tfile << base << endl;
-      tfile.flush ();
-      tfile.close ();
-    }
-  }
-  return mfn;
+  if (0 == strncmp (base_name, VAR_PREFIX, strlen (VAR_PREFIX)))
+    base_name += strlen (VAR_PREFIX);
+  else if (0 == strncmp (base_name, LAMBDA_PREFIX, strlen (LAMBDA_PREFIX)))
+    base_name += strlen (LAMBDA_PREFIX);
+  return *base_name != 0;
 }
 
+/***
+    seen is when the watcher first heard of bfr, or 0 if it was found
+    some other way.
+***/
+
 static void
-cleanup (char *dir, UTF8_string base_name, char *fn)
+handle_msg (int wd, const char *bfr, uint64_t seen)
 {
-  DIR *path;
-  struct dirent *ent;
-  if ((path = opendir (dir)) != NULL) {
-    while ((ent = readdir (path)) != NULL) {
-      if (!strncmp (ent->d_name, base_name.c_str (),
-		    base_name.size ())) {
-	char *lfn;
-	asprintf (&lfn, "%s/%s", dir, ent->d_name);
-	unlink (lfn);
-	//free (lfn);
+  uint64_t start = now_ns ();
+  counters[CNT_EVENTS]++;
+  string where;
+  if (wd == dir_wd) {
+    if (dir) where = dir;
+  }
+  else {
+    pthread_mutex_lock (&mirror_mutex);
+    auto it = mirror_dirs.find (wd);
+    if (it != mirror_dirs.end ()) where = it->second;
+    pthread_mutex_unlock (&mirror_mutex);
+  }
+  if (where.empty ()) return;		// gone since
+  char *cpy = strdup (bfr);
+  if (cpy) {
+    char *suffix = &cpy[strlen (bfr) - strlen (APL_SUFFIX)];
+    if (!strcmp (suffix, APL_SUFFIX)) {
+      char *fn = NULL;
+      asprintf (&fn, "%s/%s", where.c_str (), bfr);
+      if (fn) {
+	*suffix = 0;
+	if (names_something (cpy)) check_file (cpy, fn, seen);
+	free (fn);
       }
     }
-    closedir (path);
-  } 
-  //  if (fn) free (fn);
+    free (cpy);
+  }
+  stage_note (STG_DISPATCH, start);
 }
 
-static void
-edit_eval_handler(int sig, siginfo_t *si, void *data)
+/***
+    Interpreter side of the ring.  Returns the number of names taken.
+***/
+
+static bool
+is_apl_file (const char *name)
 {
-  close_fun (CAUSE_SHUTDOWN, NULL);
+  if (*name == '.') return false;
+  size_t len = strlen (name);
+  size_t slen = strlen (APL_SUFFIX);
+  return len > slen && !strcmp (name + len - slen, APL_SUFFIX);
 }
 
-static Token
-eval_EB (const char *edif, Value_P B, APL_Integer idx)
+static int
+rescan_dir (int wd, const char *path)
 {
-  struct sigaction eval_act;
+  int cnt = 0;
+  DIR *dp;
+  struct dirent *ent;
+  if (path && (dp = opendir (path)) != NULL) {
+    while ((ent = readdir (dp)) != NULL) {
+      if (is_apl_file (ent->d_name)) {
+	handle_msg (wd, ent->d_name, 0);
+	cnt++;
+      }
+    }
+    closedir (dp);
+  }
+  return cnt;
+}
+
+static int
+rescan ()
+{
+  counters[CNT_RESCANS]++;
+  int cnt = rescan_dir (dir_wd, dir);
+  pthread_mutex_lock (&mirror_mutex);
+  unordered_map<int, string> dirs (mirror_dirs);
+  pthread_mutex_unlock (&mirror_mutex);
+  for (auto &d : dirs) cnt += rescan_dir (d.first, d.second.c_str ());
+  return cnt;
+}
+
+static int
+drain_pending ()
+{
+  if (draining) return 0;
+  draining = true;
+  int cnt = 0;
+  while (1) {
+    uint32_t tail = ring_tail.load (memory_order_relaxed);
+    if (tail == ring_head.load (memory_order_acquire)) break;
+    char bfr[NAME_MAX + 1];
+    ring_slot_s &slot = ring[tail & (RING_SLOTS - 1)];
+    int wd = slot.wd;
+    uint64_t seen = slot.seen;
+    stage_note (STG_QUEUE, slot.queued);
+    memcpy (bfr, slot.name, sizeof(bfr));
+    ring_tail.store (tail + 1, memory_order_release);
+    trace (TR_RECV, wd, bfr);
+    handle_msg (wd, bfr, seen);
+    cnt++;
+  }
+  /***
+      Unchanged files cost a stat() each, so only the ones that
+      really changed get read and fixed.
+  ***/
+  if (rescan_needed.exchange (false)) cnt += rescan ();
+  draining = false;
+  return cnt;
+}
+
+static bool
+editors_live ()
+{
+  return live_editors > 0;
+}
+
+static bool
+session_idle ()
+{
+  return !editors_live () && !mirror_attached;
+}
+
+/***
+    Watcher side of the ring.  Returns false if the ring is full.
+***/
+
+static bool
+hand_off (int wd, const char *name, uint64_t seen)
+{
+  uint32_t head = ring_head.load (memory_order_relaxed);
+  if (head - ring_tail.load (memory_order_acquire) == RING_SLOTS) {
+    counters[CNT_DROPPED]++;
+    trace (TR_DROP, wd, name);
+    rescan_needed = true;
+    return false;
+  }
+  ring_slot_s &slot = ring[head & (RING_SLOTS - 1)];
+  slot.wd = wd;
+  slot.seen = seen;
+  slot.queued = now_ns ();
+  strncpy (slot.name, name, NAME_MAX);
+  slot.name[NAME_MAX] = 0;
+  ring_head.store (head + 1, memory_order_release);
+  trace (TR_SEND, wd, name);
+  return true;
+}
+
+/***
+    Watcher side: pid has, or may have, exited.
+***/
+
+static void
+reap_editor (pid_t pid)
+{
+  int wstatus;
+  if (waitpid (pid, &wstatus, WNOHANG) == 0) return;	// still going
+  pthread_mutex_lock (&editors_mutex);
+  auto it = editors.find (pid);
+  if (it == editors.end ()) {
+    pthread_mutex_unlock (&editors_mutex);
+    return;
+  }
+  if (it->second.pidfd != -1) {
+    epoll_ctl (epoll_fd, EPOLL_CTL_DEL, it->second.pidfd, NULL);
+    close (it->second.pidfd);
+  }
+  else polled_editors--;
+  editors.erase (it);
+  slot_release (pid);
+  trace (TR_EXIT, pid, NULL);
+  pthread_mutex_unlock (&editors_mutex);
+  pid_t was = pid;
+  server_pid.compare_exchange_strong (was, 0);
+  live_editors--;		// the next edif2 call ends an idle session
+}
+
+static void
+reap_polled ()
+{
+  vector<pid_t> pids;
+  pthread_mutex_lock (&editors_mutex);
+  for (auto &e : editors) if (e.second.pidfd == -1) pids.push_back (e.first);
+  pthread_mutex_unlock (&editors_mutex);
+  for (pid_t pid : pids) reap_editor (pid);
+}
+
+/***
+    Interpreter side: editors a session leaves behind are reaped here.
+    stop_session() only takes the ones already gone; close_fun() gives
+    the rest up to wait_ms to answer its SIGTERM, then SIGKILLs them, so
+    nothing is left as a zombie once edif2 is unloaded.
+***/
+
+static void
+reap_orphans (int wait_ms)
+{
+  int wstatus;
+  bool killed = false;
+  for (int waited = 0;; waited += 10) {
+    auto it = orphans.begin ();
+    while (it != orphans.end ())
+      if (waitpid (*it, &wstatus, WNOHANG) != 0) it = orphans.erase (it);
+      else ++it;
+    if (orphans.empty () || waited >= wait_ms) {
+      if (killed || orphans.empty () || wait_ms == 0) break;
+      for (pid_t pid : orphans) kill (pid, SIGKILL);
+      killed = true;
+      waited = wait_ms - 100;		// a SIGKILL is quick; allow 100 ms
+    }
+    usleep (10000);
+  }
+}
+
+/***
+    Only NAME.apl matters; dot files and the like are editor droppings.
+***/
+
+static bool
+wanted (const struct inotify_event *event)
+{
+  if (event->len == 0 || *event->name == 0) return false;
+  if (event->mask & IN_ISDIR) return false;
+  if ((event->mask & IN_CREATE) && event->wd != dir_wd)
+    return false;				// wait for the write
+  return is_apl_file (event->name);
+}
+
+/***
+    Watch path and every directory below it, dot directories (.git and
+    the like) and symbolic links excepted.  The .apl files found go
+    into files if it is given.  Nothing is added once gen is out of
+    date; a watch the current tree shares is left alone.
+***/
+
+static void
+mirror_add_tree (const string &path, vector<string> *files, unsigned gen)
+{
+  int wd = inotify_add_watch (inotify_fd, path.c_str (), MIRROR_MASK);
+  if (wd == -1) return;
+  pthread_mutex_lock (&mirror_mutex);
+  bool current = (gen == mirror_gen);
+  if (current) mirror_dirs[wd] = path;
+  else if (mirror_dirs.find (wd) == mirror_dirs.end ())
+    inotify_rm_watch (inotify_fd, wd);
+  pthread_mutex_unlock (&mirror_mutex);
+  if (!current) return;
+
+  DIR *dp = opendir (path.c_str ());
+  if (!dp) return;
+  vector<string> subdirs;
+  struct dirent *ent;
+  while ((ent = readdir (dp)) != NULL) {
+    if (*ent->d_name == '.') continue;
+    string sub = path + "/" + ent->d_name;
+    unsigned char type = ent->d_type;
+    if (type == DT_UNKNOWN) {
+      struct stat sb;
+      if (lstat (sub.c_str (), &sb) != 0) continue;
+      type = S_ISDIR (sb.st_mode) ? DT_DIR : S_ISREG (sb.st_mode) ? DT_REG : 0;
+    }
+    if (type == DT_DIR) subdirs.push_back (sub);
+    else if (type == DT_REG && files && is_apl_file (ent->d_name))
+      files->push_back (sub);
+  }
+  closedir (dp);
+  for (const string &sub : subdirs) mirror_add_tree (sub, files, gen);
+}
+
+static void *
+watch_fun (void *arg)
+{
+  /***
+      (wd, name) -> deadline in ns, and when the first event for
+      it came.  Files in dir each have their own
+      deadline; mirror files all wait for mirror_due, when the tree as
+      a whole has gone quiet, so a checkout of hundreds of files is
+      handed over, and fixed, in one go.
+  ***/
+  typedef struct {
+    uint64_t deadline;			// 0 for mirror files
+    uint64_t seen;			// first event, for STG_DELIVER
+  } due_s;
+  map<pair<int, string>, due_s> due;
+  uint64_t mirror_due = 0;
+  while (1) {
+    int timeout = -1;
+    if (!due.empty ()) {
+      uint64_t now = now_ns ();
+      uint64_t first = UINT64_MAX;
+      for (auto &d : due) {
+	uint64_t when = d.second.deadline ? d.second.deadline : mirror_due;
+	if (when < first) first = when;
+      }
+      timeout = (first <= now) ? 0 : (int)((first - now + 999999) / 1000000);
+    }
+    if (polled_editors > 0 && (timeout == -1 || timeout > POLL_MS))
+      timeout = POLL_MS;
+
+    /***
+	data.u64 is the descriptor in the low half and, for a pidfd,
+	the editor's pid in the high half.
+    ***/
+#define MAX_EVENTS 16
+    struct epoll_event evs[MAX_EVENTS];
+    int n = epoll_wait (epoll_fd, evs, MAX_EVENTS, timeout);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror ("internal epoll_wait error in edif2");
+      break;
+    }
+    bool stopping = false;
+    for (int i = 0; i < n; i++) {
+      pid_t pid = (pid_t)(evs[i].data.u64 >> 32);
+      if (pid) reap_editor (pid);
+      else if ((int)evs[i].data.u64 == stop_fd) stopping = true;
+    }
+    if (polled_editors > 0) reap_polled ();
+    if (n > 0) {
+#define BUF_LEN (10 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+      char buf[BUF_LEN] __attribute__ ((aligned(8)));
+      ssize_t sz;
+      while (0 < (sz = read (inotify_fd, buf, BUF_LEN))) {
+	uint64_t deadline = now_ns () + debounce_ms * 1000000ULL;
+	for (char *ptr = buf; ptr < buf + sz; ) {
+	  struct inotify_event *event = (struct inotify_event *)ptr;
+	  ptr += sizeof(struct inotify_event) + event->len;
+	  counters[CNT_INOTIFY]++;
+	  if (event->mask & IN_Q_OVERFLOW) {
+	    rescan_needed = true;
+	    continue;
+	  }
+	  bool mirrored = (event->wd != dir_wd);
+	  if (mirrored && (event->mask & IN_IGNORED)) {
+	    pthread_mutex_lock (&mirror_mutex);
+	    mirror_dirs.erase (event->wd);
+	    pthread_mutex_unlock (&mirror_mutex);
+	    continue;
+	  }
+	  if (mirrored && (event->mask & IN_ISDIR) &&
+	      event->len && *event->name != '.') {
+	    string where;
+	    pthread_mutex_lock (&mirror_mutex);
+	    auto it = mirror_dirs.find (event->wd);
+	    if (it != mirror_dirs.end ()) where = it->second;
+	    unsigned gen = mirror_gen;
+	    pthread_mutex_unlock (&mirror_mutex);
+	    if (!where.empty ()) {
+	      /***
+		  A directory moved or copied in brings files that
+		  never raised events of their own.
+	      ***/
+	      vector<string> files;
+	      mirror_add_tree (where + "/" + event->name, &files, gen);
+	      if (!files.empty ()) rescan_needed = true;
+	      mirror_due = deadline;
+	    }
+	    continue;
+	  }
+	  if (!wanted (event)) continue;
+	  if (mirrored) mirror_due = deadline;
+	  trace (TR_EVENT, event->wd, event->name);
+	  due_s d = { mirrored ? 0 : deadline, now_ns () };
+	  auto ins = due.emplace (make_pair (event->wd, string (event->name)),
+				  d);
+	  if (!ins.second) {
+	    if (!mirrored) ins.first->second.deadline = deadline;
+	    counters[CNT_MERGED]++;
+	  }
+	}
+      }
+    }
+
+    if (stopping && !stop_flush) break;
+    uint64_t now = now_ns ();
+    if (stopping || mirror_due <= now) {
+      size_t batch = 0;
+      for (auto &d : due) if (!d.second.deadline) batch++;
+      if (batch > MIRROR_BULK) {
+	for (auto it = due.begin (); it != due.end (); )
+	  if (it->second.deadline) ++it;
+	  else it = due.erase (it);
+	rescan_needed = true;
+      }
+    }
+    for (auto it = due.begin (); it != due.end (); ) {
+      uint64_t when = it->second.deadline ? it->second.deadline : mirror_due;
+      if (stopping || when <= now) {
+	// a full ring means a rescan
+	if (hand_off (it->first.first, it->first.second.c_str (),
+		      it->second.seen))
+	  stage_note (STG_DELIVER, it->second.seen);
+	it = due.erase (it);
+      }
+      else ++it;
+    }
+    if (stopping) break;		// stop_session() drains the rest
+  }
+  return NULL;
+}
+
+/***
+    Hangups, interrupts and crashes take the editors down with them.
+    Only async-signal-safe calls here: kill the editors, leave the
+    session itself to the next edif2 call or close_fun(), and pass the
+    signal on to whoever had it before.
+***/
+
+static void
+edit_eval_handler(int sig, siginfo_t *si, void *data)
+{
+  loop (i, EDITOR_SLOTS) {
+    pid_t pid = editor_slots[i].load ();
+    if (pid > 0) kill (pid, SIGTERM);
+  }
+  session_killed = 1;
+
+  loop (i, SESSION_SIG_COUNT) {
+    if (session_sigs[i] != sig) continue;
+    const struct sigaction &old = session_old[i];
+    if (old.sa_flags & SA_SIGINFO) old.sa_sigaction (sig, si, data);
+    else if (old.sa_handler == SIG_DFL) {
+      signal (sig, SIG_DFL);
+      raise (sig);
+    }
+    else if (old.sa_handler != SIG_IGN) old.sa_handler (sig);
+  }
+}
+
+static const char *
+session_failed (const char *what)
+{
+  perror (what);
+  session_busy = false;
+  stop_session (false);
+  return "Internal failure in edif2.";
+}
+
+/***
+    Returns NULL, or what went wrong.
+***/
+
+static const char *
+start_session ()
+{
+  if (watch_running) return NULL;
+  if (session_busy) return "Internal failure in edif2.";
+  session_busy = true;
+
+  pthread_mutex_lock (&mutex);
+  if (!dir) asprintf (&dir, "/var/run/user/%d/%d",
+		      (int)getuid (), (int)getpid ());
+  pthread_mutex_unlock (&mutex);
+  if (!dir) return session_failed ("internal asprintf error in edif2");
+  mkdir (dir, 0700);
+
+  struct sigaction eval_act;
   eval_act.sa_sigaction = edit_eval_handler;
   sigemptyset (&eval_act.sa_mask);
   eval_act.sa_flags = SA_SIGINFO | SA_RESTART;
-  sigaction (SIGCHLD, &eval_act, NULL);
-  sigaction (SIGABRT, &eval_act, NULL);
-  sigaction (SIGHUP,  &eval_act, NULL);
-  sigaction (SIGINT,  &eval_act, NULL);
-  sigaction (SIGQUIT, &eval_act, NULL);
-  sigaction (SIGSTOP, &eval_act, NULL);
-  sigaction (SIGTSTP, &eval_act, NULL);
-  sigaction (SIGSEGV, &eval_act, NULL);
-	      
+  loop (i, SESSION_SIG_COUNT)
+    sigaction (session_sigs[i], &eval_act, &session_old[i]);
+  session_sigs_set = true;
+
+  inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd == -1)
+    return session_failed ("internal inotify_init error in edif2");
+#ifdef CHLM_VERSION
+  int inotify_rc = inotify_add_watch (inotify_fd, dir,
+				      IN_CREATE | IN_MODIFY);
+#else
+  // patch by Hans-Peter Sorge <hanspetersorge@netscape.net>
+  // IN_MOVED_TO catches editors that save by renaming a temp file
+  int inotify_rc = inotify_add_watch(inotify_fd, dir,
+				     IN_CLOSE_WRITE | IN_MOVED_TO);
+#endif
+  // int inotify_rc = inotify_add_watch (inotify_fd, dir, IN_ALL_EVENTS);
+  if (inotify_rc == -1)
+    return session_failed ("internal inotify_add_watch error in edif2");
+  dir_wd = inotify_rc;
+
+  epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  stop_fd  = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epoll_fd == -1 || stop_fd == -1)
+    return session_failed ("internal epoll error in edif2");
+  struct epoll_event ev;
+  ev.events  = EPOLLIN;
+  ev.data.u64 = (uint32_t)inotify_fd;
+  epoll_ctl (epoll_fd, EPOLL_CTL_ADD, inotify_fd, &ev);
+  ev.data.u64 = (uint32_t)stop_fd;
+  epoll_ctl (epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev);
+  reap_orphans ();
+
+  /***
+      The watcher thread must never take a signal meant for the
+      interpreter, so start it with everything blocked.
+  ***/
+  sigset_t all, old;
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  int prc = pthread_create (&watch_thread, NULL, watch_fun, NULL);
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+  if (prc != 0) {
+    errno = prc;
+    return session_failed ("internal pthread_create error in edif2");
+  }
+  watch_running = true;
+  session_busy = false;
+  return NULL;
+}
+
+/***
+    With apply set, whatever the watcher still holds is handed over and
+    fixed before the working files go; close_fun() just throws it away.
+***/
+
+static void
+stop_session (bool apply)
+{
+  if (session_busy) return;
+  session_busy = true;
+
+  if (watch_running) {
+    stop_flush = apply;
+    uint64_t one = 1;
+    write (stop_fd, &one, sizeof(one));
+    pthread_join (watch_thread, NULL);
+    watch_running = false;
+  }
+  if (apply) drain_pending ();
+  ring_tail.store (ring_head.load ());
+  rescan_needed = false;
+
+  pthread_mutex_lock (&editors_mutex);
+  for (auto &e : editors) {
+    if (e.second.pidfd != -1) close (e.second.pidfd);
+    orphans.push_back (e.first);
+  }
+  editors.clear ();
+  loop (i, EDITOR_SLOTS) editor_slots[i] = 0;
+  live_editors = 0;
+  polled_editors = 0;
+  pthread_mutex_unlock (&editors_mutex);
+  server_pid = 0;
+  reap_orphans ();
+
+  pthread_mutex_lock (&mutex);
+  if (inotify_fd != -1) { close (inotify_fd); inotify_fd = -1; }
+  if (epoll_fd   != -1) { close (epoll_fd);   epoll_fd   = -1; }
+  if (stop_fd    != -1) { close (stop_fd);    stop_fd    = -1; }
+  /***
+      Only edif2's own files go here: edif, loaded into the same
+      interpreter, works in the same directory and made it once in its
+      get_signature(), so the directory itself waits for close_fun().
+  ***/
+  reg_clear (NULL);
+  if (dir) {
+    string sock = string (dir) + "/" SERVER_SOCKET;
+    unlink (sock.c_str ());
+  }
+  pthread_mutex_unlock (&mutex);
+  file_index.clear ();
+  var_index.clear ();
+  pthread_mutex_lock (&mirror_mutex);
+  mirror_dirs.clear ();
+  mirror_gen++;
+  pthread_mutex_unlock (&mirror_mutex);
+  mirror_root.clear ();
+  mirror_attached = 0;
+  dir_wd = -1;
+
+  if (session_sigs_set) {
+    loop (i, SESSION_SIG_COUNT) sigaction (session_sigs[i], &session_old[i], NULL);
+    session_sigs_set = false;
+  }
+  session_killed = 0;
+  session_busy = false;
+}
+
+/***
+    Loading edif2 only records the editor; everything else waits for
+    the first edit.
+***/
+
+Fun_signature
+get_signature()
+{
+  pthread_mutex_lock (&mutex);
+  if (!edif2_default) {
+    char *ed2 = getenv ("EDIF2");
+    edif2_default = strdup (ed2 ?: EDIF2_DEFAULT);
+    char *deb = getenv ("EDIF2_DEBOUNCE");
+    if (deb) debounce_ms = strtol (deb, NULL, 10);
+    char *srv = getenv ("EDIF2_SERVER");
+    if (srv) loop (m, SERVER_COUNT)
+      if (!strcmp (srv, server_names[m])) server_mode = (server_e)m;
+    char *trc = getenv ("EDIF2_TRACE");
+    if (trc && *trc) trace_path = strdup (trc);
+  }
+  pthread_mutex_unlock (&mutex);
+
+  return SIG_Z_A_F2_B;
+}
+
+// export EDIF2="emacs --geometry=80x60 -background '#ffffcc' -font 'DejaVu Sans Mono-10'"
+
+static char *
+get_fcn (const char *fn, const char *base, const UCS_string &name)
+{
+  char *mfn = NULL;
+  const Function * function = real_get_fcn (name);
+  if (function != 0) {
+    is_lambda = force_lambda || function->is_lambda();
+    if (is_lambda)
+      asprintf (&mfn, "%s/%s%s%s", dir, LAMBDA_PREFIX, base, APL_SUFFIX);
+    else
+      asprintf (&mfn, "%s/%s%s", dir, base, APL_SUFFIX);
+    
+    if (mfn) {				// freed in eval_EB
+      uint64_t start = now_ns ();
+      const string &text = render_fcn (function, base, is_lambda).text;
+      write_text (mfn, text.data (), text.size (), 0600);
+      stage_note (STG_RENDER, start);
+      note_written (mfn, text);
+      hist_note (base, text, is_lambda);
+      reg_note (base, mfn, is_lambda, false);
+    }
+  }
+  else {			// new fcn
+    if (force_lambda)
+      asprintf (&mfn, "%s/%s%s%s", dir, LAMBDA_PREFIX, base, APL_SUFFIX);
+    else
+      mfn = strdup (fn);		// freed in eval_EB
+    if (mfn) {
+      string text = base;
+      text += force_lambda ? "←" : "\n";
+      write_text (mfn, text.data (), text.size (), 0600);
+      note_written (mfn, text);
+      reg_note (base, mfn, force_lambda, false);
+    }
+  }
+  return mfn;
+}
+
+/***
+    Adapted from get_var() in edif.cc.  The file is named with
+    VAR_PREFIX so handle_msg() knows to reassign rather than fix it.
+***/
+
+static char *
+get_var (const char *base, const UCS_string &name)
+{
+  char *mfn = NULL;
+  Symbol *sym = Workspace::lookup_existing_symbol (name);
+  if (sym) {
+    Value *val = sym->get_val_wptr ();
+    if (val) {
+      var_state_s &vs = var_index[base];
+      vs.is_char = val->is_char_array ();
+      vs.shape = val->get_shape ();
+      vs.nested = !is_plain (*val);
+      asprintf (&mfn, "%s/%s%s%s", dir, VAR_PREFIX, base, APL_SUFFIX);
+      if (mfn) {			// freed in eval_EB
+	uint64_t start = now_ns ();
+	int fd = open (mfn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	const char *err = (fd == -1) ? "Error opening working file."
+	  : vs.nested ? write_nested (fd, *val) : write_value (fd, *val);
+	if (fd != -1) close (fd);
+	stage_note (STG_RENDER, start);
+	if (err) {
+	  cerr << err << endl;
+	  free (mfn);
+	  mfn = NULL;
+	}
+	else {
+	  note_written (mfn);
+	  reg_note (base, mfn, false, true);
+	}
+      }
+    }
+  }
+  return mfn;
+}
+
+/***
+    Put pid in the table and its pidfd in the watcher's epoll set.  It
+    goes in the table first, so the watcher can always find it.
+***/
+
+static void
+supervise (pid_t pid, const vector<string> &files)
+{
+  editor_s ed;
+  ed.pid = pid;
+  ed.pidfd = (int)syscall (SYS_pidfd_open, pid, 0);	// close-on-exec
+  ed.started = now_ns ();
+  for (const string &f : files) {
+    if (!ed.files.empty ()) ed.files += " ";
+    ed.files += f;
+  }
+  pthread_mutex_lock (&editors_mutex);
+  editors[pid] = ed;
+  slot_claim (pid);
+  live_editors++;
+  if (ed.pidfd == -1) polled_editors++;
+  else {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t)pid << 32) | (uint32_t)ed.pidfd;
+    epoll_ctl (epoll_fd, EPOLL_CTL_ADD, ed.pidfd, &ev);
+  }
+  pthread_mutex_unlock (&editors_mutex);
+}
+
+/***
+    Start edif on files in its own process.  Returns NULL, or what went
+    wrong.
+***/
+
+static const char *
+launch_editor (const char *edif, const vector<string> &files, pid_t *child)
+{
+  if (!watch_running) return "Internal failure.";
+
+  pid_t pid;
+  uint64_t start = now_ns ();
+  int rc = spawn_editor (edif, files, &pid, -1);
+  if (rc != 0) return "Editor process failed to start.";
+  supervise (pid, files);
+  trace (TR_SPAWN, pid, files.empty () ? NULL : files[0].c_str ());
+  stage_note (STG_SPAWN, start);
+  if (child) *child = pid;
+  return NULL;
+}
+
+/***
+    A server that has only just been started needs a moment before its
+    socket shows up.
+***/
+
+static bool
+server_ready (const char *sock)
+{
+  for (int i = 0; i < 20; i++) {
+    struct stat sb;
+    if (!stat (sock, &sb) && S_ISSOCK (sb.st_mode)) return true;
+    if (server_pid <= 0) break;
+    usleep (50000);
+  }
+  return false;
+}
+
+/***
+    Open files in the session's editor server, starting one if there
+    is none, or in a new editor if server mode is off or the server
+    will not answer.
+***/
+
+static const char *
+open_files (const char *edif, const vector<string> &files, pid_t *editor)
+{
+  if (server_mode == SERVER_NONE)
+    return launch_editor (edif, files, editor);
+
+  char *sock = NULL;
+  char *cmd = NULL;
+  const char *err = NULL;
+  asprintf (&sock, "%s/%s", dir, SERVER_SOCKET);
+  if (!sock) return "Internal failure in edif2.";
+
+  if (server_pid > 0 && server_kind == server_mode) {
+    if (server_ready (sock)) {
+      if (server_mode == SERVER_EMACS)
+	asprintf (&cmd, "emacsclient -s %s -n", sock);
+      else
+	asprintf (&cmd, "nvim --server %s --remote", sock);
+      err = cmd ? launch_editor (cmd, files, NULL)
+	: "Internal failure in edif2.";
+      *editor = server_pid;
+    }
+    else err = launch_editor (edif, files, editor);
+  }
+  else {
+    unlink (sock);			// left over from a dead server
+    if (server_mode == SERVER_EMACS)
+      asprintf (&cmd, "%s --eval '(setq server-name \"%s\")' -f server-start",
+		edif, sock);
+    else
+      asprintf (&cmd, "%s --listen %s", edif, sock);
+    pid_t pid = 0;
+    err = cmd ? launch_editor (cmd, files, &pid)
+      : "Internal failure in edif2.";
+    if (!err) {
+      server_pid = pid;
+      server_kind = server_mode;
+      *editor = pid;
+    }
+  }
+  if (cmd) free (cmd);
+  free (sock);
+  return err;
+}
+
+static void
+mirror_detach ()
+{
+  pthread_mutex_lock (&mirror_mutex);
+  mirror_gen++;
+  for (auto &d : mirror_dirs) inotify_rm_watch (inotify_fd, d.first);
+  mirror_dirs.clear ();
+  pthread_mutex_unlock (&mirror_mutex);
+  mirror_root.clear ();
+  mirror_attached = 0;
+}
+
+/***
+    Watch root and load everything in it.  Returns the number of files
+    fixed, or -1.
+***/
+
+static APL_Integer
+mirror_attach (const char *root)
+{
+  struct stat sb;
+  if (stat (root, &sb) != 0 || !S_ISDIR (sb.st_mode)) return -1;
+  if (start_session ()) return -1;
+  if (mirror_attached) mirror_detach ();
+
+  mirror_root = root;
+  while (mirror_root.size () > 1 && mirror_root.back () == '/')
+    mirror_root.pop_back ();
+  mirror_attached = 1;
+  pthread_mutex_lock (&mirror_mutex);
+  unsigned gen = ++mirror_gen;
+  pthread_mutex_unlock (&mirror_mutex);
+  vector<string> files;
+  mirror_add_tree (mirror_root, &files, gen);
+
+  APL_Integer before = counters[CNT_FIXES];
+  for (const string &f : files) {
+    size_t slash = f.rfind ('/');
+    string base (f, slash + 1, f.size () - slash - 1 - strlen (APL_SUFFIX));
+    if (names_something (base.c_str ()))
+      check_file (base.c_str (), f.c_str (), 0);
+  }
+  return counters[CNT_FIXES] - before;
+}
+
+/***
+    edif2 [10]: the registry as a matrix, one row per name being
+    edited -- name, file, form, editor pid and how the last fix went.
+***/
+
+static Value_P
+string_value (const char *str)
+{
+  UTF8_string utf (str);
+  UCS_string ucs (utf);
+  Value_P Z (ucs, LOC);
+  Z->check_value (LOC);
+  return Z;
+}
+
+static const char *fix_state_names[FIX_COUNT] =
+  { "pending", "fixed", "failed", "unchanged" };
+
+static Value_P
+registry_value ()
+{
+  vector<string> names;
+  for (auto &r : registry) names.push_back (r.first);
+  sort (names.begin (), names.end ());
+
+  Shape sh;
+  sh.add_shape_item (names.size ());
+  sh.add_shape_item (5);
+  Value_P Z (sh, LOC);
+  for (const string &n : names) {
+    const reg_entry_s &re = registry[n];
+    const char *form =
+      re.variable ? "variable" : re.lambda ? "lambda" : "function";
+    Z->next_ravel_Pointer (string_value (n.c_str ()).get ());
+    Z->next_ravel_Pointer (string_value (re.path.c_str ()).get ());
+    Z->next_ravel_Pointer (string_value (form).get ());
+    Z->next_ravel_Int (re.editor);
+    Z->next_ravel_Pointer (string_value (fix_state_names[re.fix]).get ());
+  }
+  if (names.empty ()) Z->set_default_Spc ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    edif2 [11]: one row per live editor, its pid, how many seconds it
+    has been running, and the files it was started on.
+***/
+
+static Value_P
+editors_value ()
+{
+  vector<editor_s> eds;
+  pthread_mutex_lock (&editors_mutex);
+  for (auto &e : editors) eds.push_back (e.second);
+  pthread_mutex_unlock (&editors_mutex);
+  sort (eds.begin (), eds.end (),
+	[](const editor_s &a, const editor_s &b) { return a.pid < b.pid; });
+
+  Shape sh;
+  sh.add_shape_item (eds.size ());
+  sh.add_shape_item (3);
+  Value_P Z (sh, LOC);
+  uint64_t now = now_ns ();
+  for (const editor_s &e : eds) {
+    Z->next_ravel_Int (e.pid);
+    Z->next_ravel_Int ((now - e.started) / 1000000000ULL);
+    Z->next_ravel_Pointer (string_value (e.files.c_str ()).get ());
+  }
+  if (eds.empty ()) Z->set_default_Spc ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    edif2 [12]: one row per stage -- its name, count, total and longest
+    time in microseconds, the 50th and 99th percentiles of its last
+    STG_SAMPLES runs, then the STG_BUCKETS histogram -- followed by a
+    row for each of the edif2 [4] counters, its name and count.
+***/
+
+static Value_P
+metrics_value ()
+{
+  Shape sh;
+  sh.add_shape_item (STG_COUNT + CNT_COUNT);
+  sh.add_shape_item (6 + STG_BUCKETS);
+  Value_P Z (sh, LOC);
+  loop (g, STG_COUNT) {
+    const stage_s &st = stages[g];
+    Z->next_ravel_Pointer (string_value (stage_names[g]).get ());
+    Z->next_ravel_Int (st.count);
+    Z->next_ravel_Int (st.total_ns / 1000);
+    Z->next_ravel_Int (st.max_ns / 1000);
+    Z->next_ravel_Int (stage_percentile (st, 0.50));
+    Z->next_ravel_Int (stage_percentile (st, 0.99));
+    loop (b, STG_BUCKETS) Z->next_ravel_Int (st.hist[b]);
+  }
+  loop (c, CNT_COUNT) {
+    Z->next_ravel_Pointer (string_value (counter_names[c]).get ());
+    Z->next_ravel_Int (counters[c]);
+    loop (k, 4 + STG_BUCKETS) Z->next_ravel_Int (0);
+  }
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    edif2 [13] '': the trace, oldest first, one row per record -- its
+    time in microseconds since the oldest, what happened, arg and name.
+***/
+
+static Value_P
+trace_value ()
+{
+  vector<trace_copy_s> recs = trace_snapshot ();
+  uint64_t base = recs.empty () ? 0 : recs.front ().ns;
+
+  Shape sh;
+  sh.add_shape_item (recs.size ());
+  sh.add_shape_item (4);
+  Value_P Z (sh, LOC);
+  for (const trace_copy_s &c : recs) {
+    Z->next_ravel_Int ((c.ns - base) / 1000);
+    Z->next_ravel_Pointer (string_value (trace_names[c.kind]).get ());
+    Z->next_ravel_Int (c.arg);
+    Z->next_ravel_Pointer (string_value (c.name).get ());
+  }
+  if (recs.empty ()) Z->set_default_Spc ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    edif2 [15] 'name': name's versions, newest first, one row each --
+    how far back it is, its age in seconds, its size and its text.
+    edif2 [15] '' instead says what the history holds: names, versions,
+    distinct texts and their bytes.
+***/
+
+static Value_P
+history_value (const char *name)
+{
+  if (!*name) {
+    Value_P Z (4, LOC);
+    Z->next_ravel_Int (history.size ());
+    Z->next_ravel_Int (hist_versions);
+    Z->next_ravel_Int (hist_texts.size ());
+    Z->next_ravel_Int (hist_bytes);
+    Z->check_value (LOC);
+    return Z;
+  }
+  auto it = history.find (name);
+  size_t cnt = (it == history.end ()) ? 0 : it->second.size ();
+
+  Shape sh;
+  sh.add_shape_item (cnt);
+  sh.add_shape_item (4);
+  Value_P Z (sh, LOC);
+  time_t now = time (NULL);
+  loop (back, cnt) {
+    const hist_version_s &v = *hist_find (name, back);
+    const string &text = hist_text (v);
+    Z->next_ravel_Int (back);
+    Z->next_ravel_Int (now - v.when);
+    Z->next_ravel_Int (text.size ());
+    Z->next_ravel_Pointer (string_value (text.c_str ()).get ());
+  }
+  if (cnt == 0) Z->set_default_Spc ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    edif2 [16] 'name n': fix name's version n back again, from memory.
+    n defaults to 1, the one before the newest.  Returns NULL, or what
+    went wrong.
+***/
+
+static const char *
+history_revert (const char *arg)
+{
+  string name (arg);
+  size_t back = 1;
+  while (!name.empty () && name.back () == ' ') name.pop_back ();
+  size_t blank = name.find_last_of (' ');
+  if (blank != string::npos) {
+    char *end;
+    back = strtoul (name.c_str () + blank + 1, &end, 10);
+    if (*end) return "Version number required.";
+    name.erase (blank);
+    while (!name.empty () && name.back () == ' ') name.pop_back ();
+  }
+  const hist_version_s *v = hist_find (name.c_str (), back);
+  if (!v) return "No such version.";
+
+  string text = hist_text (*v);		// hist_note() may move it
+  bool lambda = v->lambda;
+  string base = lambda ? LAMBDA_PREFIX + name : name;
+  if (!read_file (base.c_str (), text)) return "Revert failed.";
+  hist_note (name.c_str (), text, lambda);
+
+  /***
+      An open working file gets the reverted text too, noted as
+      written, so the editor can pick it up and the next save of the
+      old text is a change again rather than a skip.
+  ***/
+  reg_entry_s *re = reg_find (name.c_str ());
+  const Function *function =
+    real_get_fcn (UCS_string (UTF8_string (name.c_str ())));
+  if (re && !re->variable && re->lambda == lambda && function) {
+    const string &now = render_fcn (function, name.c_str (), lambda).text;
+    if (write_text (re->path.c_str (), now.data (), now.size (), 0600)) {
+      note_written (re->path.c_str (), now);
+      re->fix = FIX_OK;
+    }
+  }
+  return NULL;
+}
+
+/***
+    Bulk export, edif2 [8] '/some/dir': every user-defined function and
+    operator written to dir as NAME.apl, lambdas as _lambda_NAME.apl, in
+    the same form edif2 edits them.  Anything of GNU APL's, canonical()
+    and splitting it into lines included, runs on the interpreter
+    thread up front, and functions render_cache already holds skip even
+    that; turning the lines into UTF-8, hashing the text and writing it
+    out is shared among a few worker threads, which touch only
+    std::string.  A file is only rewritten if its hash differs from
+    what the last export to the same place wrote, or, the first time,
+    from what is already on disk.  A file an earlier export wrote for a
+    function that has gone since is removed, unless it has been changed
+    on disk; nothing else in the directory is touched.
+***/
+typedef struct {
+  const Function   *function;
+  APL_Integer       created;
+  string            path;
+  string            base;
+  vector<u32string> lines;	// empty if text came from render_cache
+  bool              cached;
+  string            text;
+  bool              lambda;
+  bool              known;	// old_hash is from export_index
+  uint64_t          old_hash;
+  uint64_t          hash;
+  int               status;	// 1 written, 0 unchanged, -1 failed
+} export_job_s;
+
+typedef struct {
+  vector<export_job_s> *jobs;
+  atomic<size_t> next;
+} export_pool_s;
+
+static unordered_map<string, uint64_t> export_index;
+#define EXPORT_THREADS_MAX 8
+
+static void
+export_one (export_job_s &job)
+{
+  if (!job.cached) {
+    job.text = render_lines (job.lines, job.base, job.lambda);
+    job.hash = text_hash (job.text.data (), job.text.size ());
+  }
+  const string &text = job.text;
+  if (!job.known) {
+    string old;
+    struct stat sb;
+    if (slurp (job.path.c_str (), old, sb)) {
+      job.known = true;
+      job.old_hash = text_hash (old.data (), old.size ());
+    }
+  }
+  if (job.known && job.old_hash == job.hash) {
+    job.status = 0;
+    return;
+  }
+  job.status =
+    write_text (job.path.c_str (), text.data (), text.size (), 0644) ? 1 : -1;
+}
+
+static void *
+export_worker (void *arg)
+{
+  export_pool_s *pool = (export_pool_s *)arg;
+  size_t i;
+  while ((i = pool->next++) < pool->jobs->size ())
+    export_one ((*pool->jobs)[i]);
+  return NULL;
+}
+
+/***
+    Returns NULL, or what went wrong.
+***/
+
+static const char *
+export_all (const char *to, APL_Integer &written, APL_Integer &unchanged,
+	    APL_Integer &removed)
+{
+  written = unchanged = removed = 0;
+  if (mkdir (to, 0755) == -1 && errno != EEXIST)
+    return "Cannot create the export directory.";
+
+  vector<export_job_s> jobs;
+  for (const Symbol *sym : Workspace::get_symbol_table ().get_all_symbols ()) {
+    const Function *function = real_get_fcn (sym->get_name ());
+    if (!function) continue;
+    export_job_s job;
+    UTF8_string base_utf (sym->get_name ());
+    job.function = function;
+    job.created  = creation_time (function);
+    job.base     = base_utf.c_str ();
+    job.lambda   = function->is_lambda ();
+    job.path     = string (to) + "/" + (job.lambda ? LAMBDA_PREFIX : "")
+      + job.base + APL_SUFFIX;
+    const render_s *r = render_find (function, job.base.c_str (), job.lambda);
+    job.cached   = (r != NULL);
+    if (r) {
+      job.text = r->text;
+      job.hash = r->hash;
+    }
+    else ucs_lines (function->canonical (false), job.lines);
+    auto it = export_index.find (job.path);
+    job.known    = (it != export_index.end ());
+    job.old_hash = job.known ? it->second : 0;
+    job.status   = -1;
+    jobs.push_back (std::move (job));
+  }
+
+  export_pool_s pool;
+  pool.jobs = &jobs;
+  pool.next = 0;
+  long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+  size_t nthreads = (ncpu > 1) ? ncpu : 1;
+  if (nthreads > EXPORT_THREADS_MAX) nthreads = EXPORT_THREADS_MAX;
+  if (nthreads > jobs.size () / 32 + 1) nthreads = jobs.size () / 32 + 1;
+
+  vector<pthread_t> threads;
+  sigset_t all, old;
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old);
+  for (size_t t = 1; t < nthreads; t++) {	// this thread is one too
+    pthread_t th;
+    if (0 == pthread_create (&th, NULL, export_worker, &pool))
+      threads.push_back (th);
+  }
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+  export_worker (&pool);
+  for (pthread_t th : threads) pthread_join (th, NULL);
+
+  /***
+      What was rendered here goes into render_cache while there is
+      room, so the next export, or opening one of these, starts from it.
+  ***/
+  for (export_job_s &job : jobs) {
+    if (job.cached || job.status == -1 ||
+	render_cache.size () >= RENDER_CACHE_MAX) continue;
+    render_s &r = render_cache[job.function];
+    r.created = job.created;
+    r.lambda  = job.lambda;
+    r.base    = job.base;
+    r.text    = std::move (job.text);
+    r.hash    = job.hash;
+  }
+
+  int failed = 0;
+  unordered_set<string> current;
+  for (const export_job_s &job : jobs) {
+    current.insert (job.path);
+    switch (job.status) {
+    case 1:  written++;   export_index[job.path] = job.hash; break;
+    case 0:  unchanged++; export_index[job.path] = job.hash; break;
+    default: failed++;    export_index.erase (job.path);     break;
+    }
+  }
+
+  string prefix = string (to) + "/";
+  for (auto it = export_index.begin (); it != export_index.end (); ) {
+    const string &path = it->first;
+    if (current.count (path) || path.compare (0, prefix.size (), prefix) ||
+	path.find ('/', prefix.size ()) != string::npos) {
+      ++it;
+      continue;
+    }
+    string old;
+    struct stat sb;
+    if (slurp (path.c_str (), old, sb) &&
+	text_hash (old.data (), old.size ()) == it->second &&
+	unlink (path.c_str ()) == 0)
+      removed++;
+    it = export_index.erase (it);
+  }
+  return failed ? "Some functions could not be exported." : NULL;
+}
+
+/***
+    Every defined function, operator and variable whose name matches
+    the fnmatch(3) pattern pat, in sorted order.
+***/
+
+static const char *
+match_names (const char *pat, vector<UCS_string> &names)
+{
+  vector<string> found;
+  for (const Symbol *sym : Workspace::get_symbol_table ().get_all_symbols ()) {
+    UTF8_string name_utf (sym->get_name ());
+    if (fnmatch (pat, name_utf.c_str (), 0)) continue;
+    switch (Quad_NC::get_NC (sym->get_name ()) & NC_case_mask) {
+    case NC_FUNCTION & NC_case_mask:
+    case NC_OPERATOR & NC_case_mask:
+    case NC_VARIABLE & NC_case_mask:
+      found.push_back (name_utf.c_str ());
+      break;
+    }
+  }
+  if (found.empty ()) return "No names match the pattern.";
+  sort (found.begin (), found.end ());
+  found.erase (unique (found.begin (), found.end ()), found.end ());
+  for (const string &f : found) {
+    UTF8_string f_utf (f.c_str ());
+    names.push_back (UCS_string (f_utf));
+  }
+  return NULL;
+}
+
+static const char *
+add_name (UCS_string name, vector<UCS_string> &names)
+{
+  while (name.size () && name.back () <= ' ') name.pop_back ();
+  if (name.size () == 0) return "Empty name.";
+  UTF8_string name_utf (name);
+  if (strpbrk (name_utf.c_str (), "*?["))
+    return match_names (name_utf.c_str (), names);
+  names.push_back (name);
+  return NULL;
+}
+
+/***
+    B is a name, a pattern such as 'calc*', or a vector of either.
+***/
+
+static const char *
+collect_names (Value_P B, vector<UCS_string> &names)
+{
+  if (B->is_char_string ()) return add_name (B->get_UCS_ravel (), names);
+  if (B->get_rank () > 1) return "Character string argument required.";
+  loop (i, B->element_count ()) {
+    const Cell &cell = B->get_ravel (i);
+    const char *err = NULL;
+    if (cell.is_character_cell ()) {
+      UCS_string name;
+      name.append (cell.get_char_value ());
+      err = add_name (name, names);
+    }
+    else if (cell.is_pointer_cell () &&
+	     cell.get_pointer_value ()->is_char_string ())
+      err = add_name (cell.get_pointer_value ()->get_UCS_ravel (), names);
+    else err = "Character string argument required.";
+    if (err) return err;
+  }
+  return NULL;
+}
+
+static Token
+eval_EB (const char *edif, Value_P B, APL_Integer idx)
+{
+  int applied = drain_pending ();
+  if (watch_running && session_killed) stop_session (false);
+  if (watch_running && session_idle ()) stop_session (true);
+
   force_lambda = false;
   switch(idx) {
   case 1: force_lambda = true; break;
@@ -663,101 +2363,214 @@ eval_EB (const char *edif, Value_P B, APL_Integer idx)
       return Token(TOK_APL_VALUE1, vers);
     }
     break;
-  }
-  if (B->is_char_string ()) {
-    const UCS_string  ustr = B->get_UCS_ravel();
-    UTF8_string base_name(ustr);
-    char *fn = NULL;
-    asprintf (&fn, "%s/%s%s", dir, base_name.c_str (), APL_SUFFIX);
-    char *mfn = get_fcn (fn, base_name.c_str (), B);
-    if (mfn) {
-      APL_Integer nc = Quad_NC::get_NC(ustr);
-      switch (nc & NC_case_mask) {
-      case NC_FUNCTION & NC_case_mask:
-      case NC_OPERATOR & NC_case_mask:
-      case NC_UNUSED_USER_NAME & NC_case_mask:
-	{
-	  if (watch_pid < 0) {
-	    UCS_string ucs (UTF8_string ("Internal failure."));
-	    Value_P Z (ucs, LOC);
-	    Z->check_value (LOC);
-	    return Token (TOK_APL_VALUE1, Z);
-	  }
-	  else {
-	    pid_t pid = fork ();
-	    if (pid < 0) {
-	      UCS_string ucs (UTF8_string ("Editor process failed to fork."));
-	      Value_P Z (ucs, LOC);
-	      Z->check_value (LOC);
-	      return Token (TOK_APL_VALUE1, Z);
-	    }
-	    else if (pid > 0) {		// parent
-	      
-#ifdef USE_KIDS
-	      add_a_kid (pid);
-#else
-	      int rc = setpgid (pid, group_pid);
-	      if (rc == -1) {
-		UCS_string ucs (UTF8_string ("Internal failure in edif2."));
-		Value_P Z (ucs, LOC);
-		Z->check_value (LOC);
-		return Token (TOK_APL_VALUE1, Z);
-	      }
-	      else if (group_pid == 0) group_pid = getpgid (pid);
-#endif
-	      struct sigaction chld_act;
-	      chld_act.sa_sigaction = edit_chld_handler;
-	      sigemptyset (&chld_act.sa_mask);
-	      chld_act.sa_flags = SA_SIGINFO | SA_RESTART;
-	      sigaction (SIGCHLD, &chld_act, NULL);
-	    }
-	    else if (pid == 0) {		// child
-	      char *buf;
-
-#ifdef HAVE_LIBNOTIFY
-	      notify_start ();
-#endif
-	      asprintf (&buf, "%s %s", edif, mfn);
-	      int erc = execl("/bin/sh", "sh", "-c", buf, (char *) 0);
-	      if (erc == -1) {
-		if (buf) free (buf);
-		UCS_string ucs (UTF8_string ("Editor process failed to execute."));
-		Value_P Z (ucs, LOC);
-		Z->check_value (LOC);
-		return Token (TOK_APL_VALUE1, Z);
-	      }
-	    }
-	    //	  cleanup (dir, base_name, mfn);
-	  }
+  case 4:
+    {
+      Value_P Z (CNT_COUNT, LOC);
+      loop (c, CNT_COUNT) Z->next_ravel_Int (counters[c]);
+      Z->check_value (LOC);
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 5:
+    {
+      Value_P Z = IntScalar (debounce_ms, LOC);
+      if (B->is_numeric_scalar ()) {
+	APL_Integer ms = B->get_sole_integer ();
+	if (ms >= 0) debounce_ms = ms;
+      }
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 6:
+    {
+      Value_P Z = IntScalar (applied, LOC);
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 7:
+    {
+      UTF8_string prev_utf (server_names[server_mode]);
+      UCS_string prev (prev_utf);
+      if (B->is_char_string () && B->element_count () > 0) {
+	UTF8_string want (B->get_UCS_ravel ());
+	int m;
+	for (m = 0; m < SERVER_COUNT; m++)
+	  if (!strcmp (want.c_str (), server_names[m])) break;
+	if (m == SERVER_COUNT) {
+	  UCS_string ucs (UTF8_string ("Unknown editor server."));
+	  Value_P Z (ucs, LOC);
+	  Z->check_value (LOC);
+	  return Token (TOK_APL_VALUE1, Z);
 	}
-	break;
-      case NC_VARIABLE & NC_case_mask:
-	{
-	  UCS_string ucs (UTF8_string ("Variable editing not yet implemented."));
+	server_mode = (server_e)m;
+      }
+      Value_P Z (prev, LOC);
+      Z->check_value (LOC);
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 8:
+    {
+      const char *msg = "Directory name required.";
+      APL_Integer written, unchanged, removed;
+      if (B->is_char_string () && B->element_count () > 0) {
+	UTF8_string to (B->get_UCS_ravel ());
+	msg = export_all (to.c_str (), written, unchanged, removed);
+      }
+      if (msg) {
+	UTF8_string msg_utf (msg);
+	UCS_string ucs (msg_utf);
+	Value_P Z (ucs, LOC);
+	Z->check_value (LOC);
+	return Token (TOK_APL_VALUE1, Z);
+      }
+      Value_P Z (3, LOC);
+      Z->next_ravel_Int (written);
+      Z->next_ravel_Int (unchanged);
+      Z->next_ravel_Int (removed);
+      Z->check_value (LOC);
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 9:
+    {
+      if (B->is_char_string () && B->element_count () > 0) {
+	UTF8_string root (B->get_UCS_ravel ());
+	APL_Integer fixed = mirror_attach (root.c_str ());
+	if (fixed < 0) {
+	  UCS_string ucs (UTF8_string ("Cannot watch that directory."));
 	  Value_P Z (ucs, LOC);
 	  Z->check_value (LOC);
 	  return Token (TOK_APL_VALUE1, Z);
 	}
-	break;
-      default:
-	{
-	  UCS_string ucs (UTF8_string (UTF8_string ("Unknown editing type requested.")));
+	Value_P Z = IntScalar (fixed, LOC);
+	return Token(TOK_APL_VALUE1, Z);
+      }
+      UTF8_string root_utf (mirror_root.c_str ());
+      UCS_string root (root_utf);
+      if (mirror_attached) mirror_detach ();
+      Value_P Z (root, LOC);
+      Z->check_value (LOC);
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 10:
+    return Token(TOK_APL_VALUE1, registry_value ());
+    break;
+  case 11:
+    return Token(TOK_APL_VALUE1, editors_value ());
+    break;
+  case 12:
+    return Token(TOK_APL_VALUE1, metrics_value ());
+    break;
+  case 13:
+    {
+      if (B->is_char_string () && B->element_count () > 0) {
+	UTF8_string to (B->get_UCS_ravel ());
+	APL_Integer cnt = trace_dump (to.c_str ());
+	if (cnt < 0) {
+	  UCS_string ucs (UTF8_string ("Cannot write the trace there."));
 	  Value_P Z (ucs, LOC);
 	  Z->check_value (LOC);
 	  return Token (TOK_APL_VALUE1, Z);
 	}
-	break;
+	Value_P Z = IntScalar (cnt, LOC);
+	return Token(TOK_APL_VALUE1, Z);
+      }
+      return Token(TOK_APL_VALUE1, trace_value ());
+    }
+    break;
+  case 14:
+    {
+      Value_P Z = metrics_value ();
+      metrics_reset ();
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  case 15:
+  case 16:
+    {
+      if (!B->is_char_string ()) {
+	UCS_string ucs (UTF8_string ("Character string argument required."));
+	Value_P Z (ucs, LOC);
+	Z->check_value (LOC);
+	return Token (TOK_APL_VALUE1, Z);
+      }
+      UTF8_string arg (B->get_UCS_ravel ());
+      if (idx == 15)
+	return Token(TOK_APL_VALUE1, history_value (arg.c_str ()));
+      const char *msg = history_revert (arg.c_str ());
+      if (msg) {
+	UTF8_string msg_utf (msg);
+	UCS_string ucs (msg_utf);
+	Value_P Z (ucs, LOC);
+	Z->check_value (LOC);
+	return Token (TOK_APL_VALUE1, Z);
+      }
+      Value_P Z = IntScalar (1, LOC);
+      return Token(TOK_APL_VALUE1, Z);
+    }
+    break;
+  }
+  vector<UCS_string> names;
+  const char *err = collect_names (B, names);
+  if (!err && names.empty ()) err = "Character string argument required.";
+  if (!err) err = start_session ();
+
+  /***
+      All the files are written first, then one editor gets the lot.
+      Each is still fixed on its own when it is saved.
+  ***/
+  vector<string> files;
+  vector<string> edited;
+  for (const UCS_string &name : names) {
+    if (err) break;
+    UTF8_string base_name (name);
+    APL_Integer nc = Quad_NC::get_NC (name);
+    char *mfn = NULL;
+    switch (nc & NC_case_mask) {
+    case NC_FUNCTION & NC_case_mask:
+    case NC_OPERATOR & NC_case_mask:
+    case NC_UNUSED_USER_NAME & NC_case_mask:
+      {
+	char *fn = NULL;
+	asprintf (&fn, "%s/%s%s", dir, base_name.c_str (), APL_SUFFIX);
+	if (fn) {
+	  mfn = get_fcn (fn, base_name.c_str (), name);
+	  free (fn);
+	}
       }
+      break;
+    case NC_VARIABLE & NC_case_mask:
+      mfn = get_var (base_name.c_str (), name);
+      break;
+    default:
+      err = "Unknown editing type requested.";
+      break;
+    }
+    if (mfn) {
+      files.push_back (mfn);
+      edited.push_back (base_name.c_str ());
       free (mfn);
     }
-    return Token(TOK_APL_VALUE1, Str0_0 (LOC));	// in case nothing works
   }
-  else {
-    UCS_string ucs (UTF8_string ("Character string argument required."));
+  if (!err && !files.empty ()) {
+    pid_t editor = 0;
+    err = open_files (edif, files, &editor);
+    for (const string &e : edited) {
+      reg_entry_s *re = reg_find (e.c_str ());
+      if (re) re->editor = editor;
+    }
+  }
+
+  if (err) {
+    UTF8_string err_utf (err);
+    UCS_string ucs (err_utf);
     Value_P Z (ucs, LOC);
     Z->check_value (LOC);
     return Token (TOK_APL_VALUE1, Z);
   }
+  return Token(TOK_APL_VALUE1, Str0_0 (LOC));	// in case nothing works
 }
 
 
@@ -0,0 +1,166 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDIF_HISTORY_HH
+#define EDIF_HISTORY_HH
+
+/***
+    The last HIST_DEPTH definitions of every function edif2 has opened
+    or fixed, so that any of them can be put back straight from memory.
+    Each text is kept once, in hist_texts, keyed by text_hash() and
+    counted by the versions that use it, so saving the same text back
+    and forth, or reverting to it, costs a small entry and nothing
+    more.  When the texts together pass HIST_BYTES the oldest versions
+    go first, whichever name they belong to.
+***/
+
+#include <stdint.h>
+#include <time.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include "edif_text.hh"
+
+#define HIST_DEPTH 16
+#define HIST_BYTES (8 * 1024 * 1024)
+
+typedef struct {
+  std::string text;
+  int         refs;
+} hist_text_s;
+
+typedef struct {
+  uint64_t hash;
+  uint64_t seq;			// order among all versions
+  time_t   when;
+  bool     lambda;
+} hist_version_s;
+
+typedef std::deque<hist_version_s> hist_versions_t;
+
+static std::unordered_map<uint64_t, hist_text_s> hist_texts;
+static std::unordered_map<std::string, hist_versions_t> history;
+static size_t   hist_bytes    = 0;
+static size_t   hist_versions = 0;
+static uint64_t hist_seq      = 0;
+
+static void
+hist_release (uint64_t hash)
+{
+  auto it = hist_texts.find (hash);
+  if (it == hist_texts.end () || --it->second.refs > 0) return;
+  hist_bytes -= it->second.text.size ();
+  hist_texts.erase (it);
+}
+
+static void
+hist_pop (hist_versions_t &vers)
+{
+  hist_release (vers.front ().hash);
+  vers.pop_front ();
+  hist_versions--;
+}
+
+/***
+    The oldest version of all, found by looking at the oldest of each
+    name.  Only runs when the byte limit is passed.
+***/
+
+static void
+hist_evict ()
+{
+  auto oldest = history.end ();
+  for (auto it = history.begin (); it != history.end (); ++it)
+    if (!it->second.empty () &&
+	(oldest == history.end () ||
+	 it->second.front ().seq < oldest->second.front ().seq))
+      oldest = it;
+  if (oldest == history.end ()) return;
+  hist_pop (oldest->second);
+  if (oldest->second.empty ()) history.erase (oldest);
+}
+
+/***
+    text becomes name's newest version, unless it already is.  A text
+    whose hash is taken by a different text is let go rather than
+    mixed up with it.
+***/
+
+static void
+hist_note (const char *name, const std::string &text, bool lambda)
+{
+  uint64_t hash = text_hash (text.data (), text.size ());
+  hist_versions_t &vers = history[name];
+  if (!vers.empty () && vers.back ().hash == hash) return;
+
+  auto ins = hist_texts.emplace (hash, hist_text_s ());
+  hist_text_s &ht = ins.first->second;
+  if (ins.second) {
+    ht.text = text;
+    ht.refs = 0;
+    hist_bytes += text.size ();
+  }
+  else if (ht.text != text) {
+    if (vers.empty ()) history.erase (name);
+    return;
+  }
+  ht.refs++;
+
+  hist_version_s v;
+  v.hash   = hash;
+  v.seq    = ++hist_seq;
+  v.when   = time (NULL);
+  v.lambda = lambda;
+  vers.push_back (v);
+  hist_versions++;
+  if (vers.size () > HIST_DEPTH) hist_pop (vers);
+  while (hist_bytes > HIST_BYTES && hist_versions > 1) hist_evict ();
+}
+
+/***
+    name's version back versions before the newest, which is 0, or
+    NULL.
+***/
+
+static const hist_version_s *
+hist_find (const char *name, size_t back)
+{
+  auto it = history.find (name);
+  if (it == history.end () || back >= it->second.size ()) return NULL;
+  return &it->second[it->second.size () - 1 - back];
+}
+
+static const std::string &
+hist_text (const hist_version_s &v)
+{
+  return hist_texts[v.hash].text;
+}
+
+static void
+hist_clear ()
+{
+  history.clear ();
+  hist_texts.clear ();
+  hist_bytes = hist_versions = 0;
+}
+
+#endif  // EDIF_HISTORY_HH
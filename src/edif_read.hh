@@ -0,0 +1,66 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDIF_READ_HH
+#define EDIF_READ_HH
+
+/***
+    Reading an edited function back, shared by edif and edif2.
+
+    Rather than getline() and append_UTF8() a line at a time, with the
+    UCS_string growing as it goes, the text is decoded in one pass:
+    the code points are counted first, eight bytes at a time, so the
+    UCS_string can be sized once, and runs of plain ASCII are then
+    copied eight bytes at a time too.  Malformed UTF-8 becomes U+FFFD.
+    The result is what the line-by-line loop produced -- every line
+    ended by LF -- together with the first line on its own, which is
+    all a lambda needs.
+
+    edif reads the file through mmap(), the editor having exited by
+    then.  edif2 already holds the bytes, which it needs for hashing,
+    and a file it is watching can still be truncated by the editor
+    while mapped, which would mean SIGBUS, so it decodes from its own
+    buffer instead.  The counting and decoding themselves are in
+    edif_text.hh.
+***/
+
+#include "Native_interface.hh"
+#include "edif_text.hh"
+
+/***
+    Appends the text in p to ucs, ending the last line with LF if the
+    file did not, and, if first is given, its first line without the LF.
+***/
+
+static void
+text_to_ucs (const char *p, size_t len, UCS_string &ucs, UCS_string *first)
+{
+  ucs.reserve (ucs.size () + utf8_count (p, len) + 1);
+  decode_utf8<UCS_string, Unicode> (p, len, ucs);
+  if (len > 0 && p[len - 1] != '\n') ucs.append (UNI_LF);
+  if (first) {
+    const char *eol = (const char *)memchr (p, '\n', len);
+    decode_utf8<UCS_string, Unicode> (p, eol ? (size_t)(eol - p) : len,
+				     *first);
+  }
+}
+
+#endif  // EDIF_READ_HH
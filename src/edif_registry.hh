@@ -0,0 +1,121 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDIF_REGISTRY_HH
+#define EDIF_REGISTRY_HH
+
+/***
+    The session's working files, shared by edif and edif2.  Every name
+    being edited maps to its file, the form it was written in, the
+    editor that has it and how its last fix went, so cleaning up after
+    an edit is a couple of unlink()s rather than a scan of the whole
+    directory for names with the same prefix -- which took fubar.apl
+    away along with fu.apl.
+***/
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <unordered_map>
+
+typedef enum {
+  FIX_NONE,		// written, not saved since
+  FIX_OK,
+  FIX_FAILED,
+  FIX_UNCHANGED,	// saved, but the same as what is in the workspace
+  FIX_COUNT
+} fix_state_e;
+
+typedef struct {
+  std::string path;
+  bool        lambda;
+  bool        variable;
+  pid_t       editor;		// 0 until one is started
+  fix_state_e fix;
+} reg_entry_s;
+
+static std::unordered_map<std::string, reg_entry_s> registry;
+
+static inline reg_entry_s &
+reg_note (const char *name, const char *path, bool lambda, bool variable)
+{
+  reg_entry_s &re = registry[name];
+  re.path     = path;
+  re.lambda   = lambda;
+  re.variable = variable;
+  re.editor   = 0;
+  re.fix      = FIX_NONE;
+  return re;
+}
+
+static inline reg_entry_s *
+reg_find (const char *name)
+{
+  auto it = registry.find (name);
+  return (it == registry.end ()) ? NULL : &it->second;
+}
+
+static inline void
+reg_unlink (const std::string &path)
+{
+  unlink (path.c_str ());
+  std::string backup = path + "~";		// emacs, among others
+  unlink (backup.c_str ());
+}
+
+static inline void
+reg_forget (const char *name)
+{
+  auto it = registry.find (name);
+  if (it == registry.end ()) return;
+  reg_unlink (it->second.path);
+  registry.erase (it);
+}
+
+/***
+    Everything registered, then dir itself.  Only if an editor has
+    left something else behind is the directory swept.
+***/
+
+static inline void
+reg_clear (const char *dir)
+{
+  for (auto &r : registry) reg_unlink (r.second.path);
+  registry.clear ();
+  if (!dir || rmdir (dir) == 0 || errno == ENOENT) return;
+
+  DIR *path;
+  struct dirent *ent;
+  if ((path = opendir (dir)) != NULL) {
+    while ((ent = readdir (path)) != NULL) {
+      char *lfn;
+      if (asprintf (&lfn, "%s/%s", dir, ent->d_name) < 0) continue;
+      unlink (lfn);
+      free (lfn);
+    }
+    closedir (path);
+  }
+  rmdir (dir);
+}
+
+#endif  // EDIF_REGISTRY_HH
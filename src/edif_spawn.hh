@@ -0,0 +1,167 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDIF_SPAWN_HH
+#define EDIF_SPAWN_HH
+
+/***
+    Starting the editor, shared by edif and edif2.
+
+    The EDIF/EDIF2 command is split into words once for each distinct
+    command string and run directly with posix_spawnp(), which does not
+    copy the interpreter's address space the way fork() does.  Quoting
+    is handled as the shell would -- '...', "..." and backslash -- so
+    the usual
+
+      emacs --geometry=60x20 -font 'DejaVu Sans Mono-10'
+
+    needs no shell.  Only a command with pipes, redirections,
+    variables, wildcards and so on outside quotes is run through
+    /bin/sh -c, with the file names appended as before.
+***/
+
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern char **environ;
+
+typedef struct {
+  std::vector<std::string> words;
+  bool shell;
+} spawn_cmd_s;
+
+/***
+    Returns false if cmd needs a shell.
+***/
+
+static bool
+split_command (const char *cmd, std::vector<std::string> &words)
+{
+  std::string w;
+  bool in_word = false;
+  for (const char *p = cmd; *p; p++) {
+    char c = *p;
+    if (c == ' ' || c == '\t') {
+      if (in_word) words.push_back (w);
+      w.clear ();
+      in_word = false;
+      continue;
+    }
+    in_word = true;
+    if (c == '\'') {
+      const char *q = strchr (p + 1, '\'');
+      if (!q) return false;
+      w.append (p + 1, q - p - 1);
+      p = q;
+    }
+    else if (c == '"') {
+      for (p++; *p && *p != '"'; p++) {
+	if (*p == '$' || *p == '`') return false;
+	if (*p == '\\' && p[1] && strchr ("\"\\$`", p[1])) p++;
+	w += *p;
+      }
+      if (!*p) return false;
+    }
+    else if (c == '\\') {
+      if (!p[1]) return false;
+      w += *++p;
+    }
+    else if (strchr ("|&;<>()$`*?[]{}#~!\n", c)) return false;
+    else if (c == '=' && words.empty ()) return false;	// VAR=value cmd
+    else w += c;
+  }
+  if (in_word) words.push_back (w);
+  return !words.empty ();
+}
+
+static const spawn_cmd_s &
+spawn_command (const char *cmd)
+{
+  static std::unordered_map<std::string, spawn_cmd_s> cache;
+  auto it = cache.find (cmd);
+  if (it != cache.end ()) return it->second;
+  spawn_cmd_s &sc = cache[cmd];
+  sc.shell = !split_command (cmd, sc.words);
+  if (sc.shell) sc.words.clear ();
+  return sc;
+}
+
+/***
+    Start cmd on files.  If pgrp is not -1 the editor is put in that
+    process group, 0 meaning a new one of its own.  Returns 0 or an
+    errno value.
+***/
+
+static int
+spawn_editor (const char *cmd, const std::vector<std::string> &files,
+	      pid_t *pid, pid_t pgrp)
+{
+  const spawn_cmd_s &sc = spawn_command (cmd);
+  std::vector<char *> argv;
+  std::string line;
+  if (sc.shell) {
+    line = cmd;
+    for (const std::string &f : files) {
+      line += ' ';
+      line += f;
+    }
+    argv.push_back ((char *)"sh");
+    argv.push_back ((char *)"-c");
+    argv.push_back ((char *)line.c_str ());
+  }
+  else {
+    for (const std::string &w : sc.words) argv.push_back ((char *)w.c_str ());
+    for (const std::string &f : files) argv.push_back ((char *)f.c_str ());
+  }
+  argv.push_back (NULL);
+
+  /***
+      The editor should not inherit whatever the interpreter happens to
+      be blocking at the moment, nor SIGINT and SIGQUIT ignored while
+      edif waits for it, as system() does.
+  ***/
+  posix_spawnattr_t attr;
+  sigset_t none, dflt;
+  sigemptyset (&none);
+  sigemptyset (&dflt);
+  sigaddset (&dflt, SIGINT);
+  sigaddset (&dflt, SIGQUIT);
+  posix_spawnattr_init (&attr);
+  short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+  posix_spawnattr_setsigmask (&attr, &none);
+  posix_spawnattr_setsigdefault (&attr, &dflt);
+  if (pgrp != -1) {
+    flags |= POSIX_SPAWN_SETPGROUP;
+    posix_spawnattr_setpgroup (&attr, pgrp);
+  }
+  posix_spawnattr_setflags (&attr, flags);
+  int rc = sc.shell
+    ? posix_spawn  (pid, "/bin/sh", NULL, &attr, argv.data (), environ)
+    : posix_spawnp (pid, argv[0],   NULL, &attr, argv.data (), environ);
+  posix_spawnattr_destroy (&attr);
+  return rc;
+}
+
+#endif  // EDIF_SPAWN_HH
@@ -0,0 +1,244 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDIF_TEXT_HH
+#define EDIF_TEXT_HH
+
+/***
+    The part of reading and writing working files that needs nothing
+    from GNU APL: mapping a file, counting, decoding and encoding UTF-8,
+    hashing text, writing it out.  decode_utf8() appends to anything S
+    with an append() taking a single character of type C; edif_read.hh
+    hands it a UCS_string.
+    Like edif_spawn.hh and edif_registry.hh, this header includes only
+    system headers, so all three build and run without GNU APL.
+***/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+
+#define UTF8_HIGH_BITS 0x8080808080808080ULL
+#define UTF8_BAD       0xFFFD
+
+typedef struct {
+  const char *data;
+  size_t      size;
+  size_t      map_size;		// 0 if nothing was mapped
+} mapped_file_s;
+
+static inline bool
+map_file (const char *fn, mapped_file_s &mf)
+{
+  mf.data = "";
+  mf.size = mf.map_size = 0;
+  int fd = open (fn, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  struct stat sb;
+  bool ok = (0 == fstat (fd, &sb));
+  if (ok && sb.st_size > 0) {
+    void *m = mmap (NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) ok = false;
+    else {
+      mf.data = (const char *)m;
+      mf.size = mf.map_size = sb.st_size;
+    }
+  }
+  close (fd);
+  return ok;
+}
+
+static inline void
+unmap_file (mapped_file_s &mf)
+{
+  if (mf.map_size) munmap ((void *)mf.data, mf.map_size);
+  mf.data = "";
+  mf.size = mf.map_size = 0;
+}
+
+/***
+    Number of code points, i.e. of bytes that are not 10xxxxxx.
+***/
+
+static inline size_t
+utf8_count (const char *p, size_t len)
+{
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy (&w, p + i, 8);
+    uint64_t cont = w & ~(w << 1) & UTF8_HIGH_BITS;
+    n += 8 - __builtin_popcountll (cont);
+  }
+  for (; i < len; i++) n += ((p[i] & 0xc0) != 0x80);
+  return n;
+}
+
+template <typename S, typename C>
+static inline void
+decode_utf8 (const char *p, size_t len, S &ucs)
+{
+  size_t i = 0;
+  while (i < len) {
+    if (i + 8 <= len) {
+      uint64_t w;
+      memcpy (&w, p + i, 8);
+      if (!(w & UTF8_HIGH_BITS)) {
+	for (int k = 0; k < 8; k++) ucs.append ((C)p[i + k]);
+	i += 8;
+	continue;
+      }
+    }
+    unsigned char c = p[i];
+    if (c < 0x80) {
+      ucs.append ((C)c);
+      i++;
+      continue;
+    }
+    /***
+	The lead byte fixes the length and the range of the second
+	byte, which rules out overlong forms, surrogates and anything
+	past U+10FFFF; a bad sequence becomes one U+FFFD for as much of
+	it as was valid, as the Unicode standard recommends.
+    ***/
+    size_t n;
+    uint32_t cp;
+    unsigned char lo = 0x80, hi = 0xbf;
+    if      (c >= 0xc2 && c <= 0xdf) { n = 1; cp = c & 0x1f; }
+    else if (c >= 0xe0 && c <= 0xef) {
+      n = 2;
+      cp = c & 0x0f;
+      if (c == 0xe0) lo = 0xa0;
+      if (c == 0xed) hi = 0x9f;
+    }
+    else if (c >= 0xf0 && c <= 0xf4) {
+      n = 3;
+      cp = c & 0x07;
+      if (c == 0xf0) lo = 0x90;
+      if (c == 0xf4) hi = 0x8f;
+    }
+    else {
+      ucs.append ((C)UTF8_BAD);
+      i++;
+      continue;
+    }
+    size_t k;
+    for (k = 1; k <= n && i + k < len; k++) {
+      unsigned char cc = p[i + k];
+      if (cc < lo || cc > hi) break;
+      cp = (cp << 6) | (cc & 0x3f);
+      lo = 0x80;
+      hi = 0xbf;
+    }
+    if (k <= n) {
+      ucs.append ((C)UTF8_BAD);
+      i += k;
+      continue;
+    }
+    ucs.append ((C)cp);
+    i += n + 1;
+  }
+}
+
+/***
+    The UTF-8 for the n code points at p, appended to out.  Anything
+    that is not a Unicode scalar value becomes U+FFFD.
+***/
+
+static inline void
+encode_utf8 (const char32_t *p, size_t n, std::string &out)
+{
+  for (size_t i = 0; i < n; i++) {
+    uint32_t cp = p[i];
+    if (cp < 0x80) {
+      out += (char)cp;
+      continue;
+    }
+    if (cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) cp = UTF8_BAD;
+    if (cp < 0x800) {
+      out += (char)(0xc0 | (cp >> 6));
+    }
+    else if (cp < 0x10000) {
+      out += (char)(0xe0 | (cp >> 12));
+      out += (char)(0x80 | ((cp >> 6) & 0x3f));
+    }
+    else {
+      out += (char)(0xf0 | (cp >> 18));
+      out += (char)(0x80 | ((cp >> 12) & 0x3f));
+      out += (char)(0x80 | ((cp >> 6) & 0x3f));
+    }
+    out += (char)(0x80 | (cp & 0x3f));
+  }
+}
+
+/***
+    Not cryptographic, just quick: eight bytes at a time through a
+    multiply/rotate mix, then the tail.
+***/
+
+static inline uint64_t
+text_hash (const char *p, size_t len)
+{
+  const uint64_t m = 0x9e3779b97f4a7c15ULL;
+  uint64_t h = len * m;
+  while (len >= 8) {
+    uint64_t w;
+    memcpy (&w, p, 8);
+    h = ((h ^ w) * m);
+    h ^= h >> 29;
+    p += 8;
+    len -= 8;
+  }
+  uint64_t w = 0;
+  memcpy (&w, p, len);
+  h = ((h ^ w) * m);
+  h ^= h >> 32;
+  return h;
+}
+
+/***
+    fn replaced by the len bytes at p, in a single write() unless the
+    kernel takes less.  Returns false if any of it could not be written.
+***/
+
+static inline bool
+write_text (const char *fn, const char *p, size_t len, mode_t mode)
+{
+  int fd = open (fn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+  if (fd == -1) return false;
+  while (len > 0) {
+    ssize_t n = write (fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    p += n;
+    len -= n;
+  }
+  close (fd);
+  return len == 0;
+}
+
+#endif  // EDIF_TEXT_HH
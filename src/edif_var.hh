@@ -0,0 +1,967 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDIF_VAR_HH
+#define EDIF_VAR_HH
+
+/***
+    Reading edited variables, shared by edif and edif2.
+
+    The edited text of a simple array is turned straight into a Value
+    and assigned to the variable, rather than being glued into one big
+    name←shape⍴... expression for the interpreter to tokenise all over
+    again.  The shape comes from the text itself, so rows can be added
+    or removed:
+
+      rank 0 or 1	every item in the file, as a scalar or vector
+      rank 2		one row per line
+      rank 3 and up	planes separated by blank lines, the axes
+			between the first and the last two kept from
+			the old shape
+
+    Numbers are written as APL displays them -- 42 ¯3 1.5E¯7 2J¯1.5.
+
+    Going the other way, write_value() streams a simple array to a file
+    a row at a time through a fixed-size buffer, so exporting a huge
+    array needs no more memory than one row's worth of column widths.
+
+    Nested and mixed arrays use a line-per-item format instead, written
+    by write_nested() and read back by nested_to_value().  Each line is
+    indented two spaces per level of depth and starts with a type
+    marker, then the shape, then, for simple arrays, a colon and the
+    ravel:
+
+      ⊂ 2 2		a general array; its four items follow, one level
+			deeper (an empty one is followed by its prototype)
+      # 3 : 1 ¯2 3J4	a simple numeric array
+      ' 5 : hello	a simple character array, \n \r and \\ escaped
+			and a trailing blank written as \s
+      # : 42		no shape, so a scalar
+
+    Both directions take time linear in the size of the text.
+***/
+
+#include <charconv>
+#include <cmath>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Native_interface.hh"
+
+typedef struct {
+  enum { NUM_INT, NUM_FLOAT, NUM_COMPLEX } kind;
+  APL_Integer ival;
+  APL_Float   re;
+  APL_Float   im;
+} num_cell_s;
+
+typedef struct {
+  size_t start;
+  size_t len;
+} text_line_s;
+
+/***
+    from_chars() also takes inf and nan, which APL has no way to hold.
+***/
+
+static bool
+parse_real (const char *p, const char *e, APL_Float &val)
+{
+  std::from_chars_result res = std::from_chars (p, e, val);
+  return res.ec == std::errc () && res.ptr == e && std::isfinite (val);
+}
+
+static bool
+parse_number (const char *tok, size_t len, num_cell_s &cell)
+{
+  char buf[128];
+  size_t n = 0;
+  size_t jpos = std::string::npos;
+  bool is_int = true;
+  for (size_t i = 0; i < len; i++) {
+    if (n >= sizeof(buf) - 1) return false;
+    unsigned char c = tok[i];
+    if (c == 0xC2 && i + 1 < len && (unsigned char)tok[i + 1] == 0xAF) {
+      buf[n++] = '-';				// ¯
+      i++;
+    }
+    else if (c == 'J' || c == 'j') {
+      if (jpos != std::string::npos) return false;
+      jpos = n;
+      buf[n++] = 'J';
+    }
+    else {
+      if (c == '.' || c == 'E' || c == 'e') is_int = false;
+      buf[n++] = c;
+    }
+  }
+  if (n == 0) return false;
+
+  if (jpos != std::string::npos) {
+    cell.kind = num_cell_s::NUM_COMPLEX;
+    return parse_real (buf, buf + jpos, cell.re) &&
+      parse_real (buf + jpos + 1, buf + n, cell.im);
+  }
+  if (is_int) {
+    std::from_chars_result res = std::from_chars (buf, buf + n, cell.ival);
+    if (res.ec == std::errc () && res.ptr == buf + n) {
+      cell.kind = num_cell_s::NUM_INT;
+      return true;
+    }
+    // too big for an integer, try it as a float
+  }
+  cell.kind = num_cell_s::NUM_FLOAT;
+  return parse_real (buf, buf + n, cell.re);
+}
+
+static void
+split_lines (const std::string &text, std::vector<text_line_s> &lines)
+{
+  size_t pos = 0;
+  while (pos < text.size ()) {
+    size_t eol = text.find ('\n', pos);
+    if (eol == std::string::npos) eol = text.size ();
+    size_t len = eol - pos;
+    if (len > 0 && text[pos + len - 1] == '\r') len--;
+    lines.push_back ({pos, len});
+    pos = eol + 1;
+  }
+  while (!lines.empty () && lines.back ().len == 0) lines.pop_back ();
+}
+
+static inline bool
+is_blank (char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+/***
+    The product of the axes between the first and the last two, i.e.
+    the number of planes each step along the first axis covers.
+***/
+
+static ShapeItem
+inner_planes (const Shape &old_shape)
+{
+  ShapeItem lead = 1;
+  for (uRank r = 1; r + 2 < old_shape.get_rank (); r++)
+    lead *= old_shape.get_shape_item (r);
+  return lead;
+}
+
+static Shape
+planar_shape (const Shape &old_shape, ShapeItem planes,
+	      ShapeItem rows, ShapeItem cols)
+{
+  Shape shape;
+  shape.add_shape_item (planes / inner_planes (old_shape));
+  for (uRank r = 1; r + 2 < old_shape.get_rank (); r++)
+    shape.add_shape_item (old_shape.get_shape_item (r));
+  shape.add_shape_item (rows);
+  shape.add_shape_item (cols);
+  return shape;
+}
+
+static Value_P
+text_to_num_value (const std::string &text,
+		   const std::vector<text_line_s> &lines,
+		   const Shape &old_shape, const char *&err)
+{
+  std::vector<num_cell_s> cells;
+  std::vector<ShapeItem> row_len;
+  std::vector<ShapeItem> plane_rows;
+  ShapeItem rows = 0;
+
+  for (const text_line_s &line : lines) {
+    const char *p = text.data () + line.start;
+    const char *e = p + line.len;
+    ShapeItem cnt = 0;
+    while (p < e) {
+      while (p < e && is_blank (*p)) p++;
+      const char *tok = p;
+      while (p < e && !is_blank (*p)) p++;
+      if (p == tok) break;
+      num_cell_s cell;
+      if (!parse_number (tok, p - tok, cell)) {
+	err = "Invalid number.";
+	return Value_P ();
+      }
+      cells.push_back (cell);
+      cnt++;
+    }
+    if (cnt == 0) {
+      if (rows > 0) plane_rows.push_back (rows);
+      rows = 0;
+    }
+    else {
+      row_len.push_back (cnt);
+      rows++;
+    }
+  }
+  if (rows > 0) plane_rows.push_back (rows);
+
+  uRank old_rank = old_shape.get_rank ();
+  Shape shape;
+  if (old_rank == 0 && cells.size () == 1) ;		// scalar
+  else if (old_rank <= 1 || row_len.empty ())
+    shape.add_shape_item (cells.size ());
+  else {
+    ShapeItem cols = row_len[0];
+    for (ShapeItem len : row_len) {
+      if (len != cols) {
+	err = "Rows differ in length.";
+	return Value_P ();
+      }
+    }
+    if (old_rank == 2) {
+      shape.add_shape_item (row_len.size ());
+      shape.add_shape_item (cols);
+    }
+    else {
+      for (ShapeItem pr : plane_rows) {
+	if (pr != plane_rows[0]) {
+	  err = "Planes differ in height.";
+	  return Value_P ();
+	}
+      }
+      ShapeItem lead = inner_planes (old_shape);
+      if (lead == 0 || plane_rows.size () % lead) {
+	err = "Planes don't fit the shape.";
+	return Value_P ();
+      }
+      shape = planar_shape (old_shape, plane_rows.size (),
+			    plane_rows[0], cols);
+    }
+  }
+
+  Value_P Z (shape, LOC);
+  for (const num_cell_s &cell : cells) {
+    switch (cell.kind) {
+    case num_cell_s::NUM_INT:     Z->next_ravel_Int (cell.ival);	break;
+    case num_cell_s::NUM_FLOAT:   Z->next_ravel_Float (cell.re);	break;
+    case num_cell_s::NUM_COMPLEX: Z->next_ravel_Complex (cell.re, cell.im);
+      break;
+    }
+  }
+  if (cells.empty ()) Z->set_default_Zero ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+static Value_P
+text_to_char_value (const std::string &text,
+		    const std::vector<text_line_s> &lines,
+		    const Shape &old_shape, const char *&err)
+{
+  std::vector<UCS_string> rows;
+  for (const text_line_s &line : lines) {
+    std::string bytes (text, line.start, line.len);
+    UTF8_string utf (bytes.c_str ());
+    rows.push_back (UCS_string (utf));
+  }
+
+  uRank old_rank = old_shape.get_rank ();
+  Shape shape;
+  std::vector<const UCS_string *> used;
+  if (old_rank == 0) {
+    if (!rows.empty () && !rows[0].empty ()) {
+      Value_P Z (shape, LOC);
+      Z->next_ravel_Char (rows[0][0]);
+      Z->check_value (LOC);
+      return Z;
+    }
+    err = "No value.";
+    return Value_P ();
+  }
+  else if (old_rank == 1) {		// lines are LFs within the string
+    ShapeItem len = 0;
+    loop (r, rows.size ()) len += rows[r].size () + (r ? 1 : 0);
+    shape.add_shape_item (len);
+    Value_P Z (shape, LOC);
+    loop (r, rows.size ()) {
+      if (r) Z->next_ravel_Char (UNI_LF);
+      loop (c, rows[r].size ()) Z->next_ravel_Char (rows[r][c]);
+    }
+    if (len == 0) Z->set_default_Spc ();
+    Z->check_value (LOC);
+    return Z;
+  }
+  else if (old_rank == 2) {
+    for (const UCS_string &row : rows) used.push_back (&row);
+  }
+  else {
+    /***
+	APL shows one blank line between planes, two between groups of
+	planes and so on, so after each plane skip at most rank-2 blank
+	lines.
+    ***/
+    ShapeItem plane_rows = old_shape.get_shape_item (old_rank - 2);
+    if (plane_rows == 0) {
+      err = "Planes don't fit the shape.";
+      return Value_P ();
+    }
+    size_t r = 0;
+    while (r < rows.size ()) {
+      for (ShapeItem pr = 0; pr < plane_rows; pr++) {
+	if (r < rows.size ()) used.push_back (&rows[r++]);
+	else used.push_back (NULL);		// short last plane
+      }
+      for (uRank s = 0; s + 2 < old_rank && r < rows.size () &&
+	     rows[r].empty (); s++) r++;
+    }
+  }
+
+  ShapeItem cols = 0;
+  for (const UCS_string *row : used)
+    if (row && (ShapeItem)row->size () > cols) cols = row->size ();
+  if (old_rank == 2) {
+    shape.add_shape_item (used.size ());
+    shape.add_shape_item (cols);
+  }
+  else {
+    ShapeItem plane_rows = old_shape.get_shape_item (old_rank - 2);
+    ShapeItem planes = used.size () / plane_rows;
+    ShapeItem lead = inner_planes (old_shape);
+    if (lead == 0 || planes % lead) {
+      err = "Planes don't fit the shape.";
+      return Value_P ();
+    }
+    shape = planar_shape (old_shape, planes, plane_rows, cols);
+  }
+
+  Value_P Z (shape, LOC);
+  for (const UCS_string *row : used) {
+    ShapeItem len = row ? row->size () : 0;
+    loop (c, cols) Z->next_ravel_Char (c < len ? (*row)[c] : UNI_SPACE);
+  }
+  if (used.empty () || cols == 0) Z->set_default_Spc ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    Returns an empty Value_P and sets err if the text won't do.
+***/
+
+static Value_P
+text_to_value (const std::string &text, bool is_char,
+	       const Shape &old_shape, const char *&err)
+{
+  err = NULL;
+  std::vector<text_line_s> lines;
+  split_lines (text, lines);
+  return is_char ? text_to_char_value (text, lines, old_shape, err)
+                 : text_to_num_value (text, lines, old_shape, err);
+}
+
+static const char *
+assign_text (const UCS_string &name, const std::string &text, bool is_char,
+	     const Shape &old_shape)
+{
+  const char *err = NULL;
+  Value_P Z = text_to_value (text, is_char, old_shape, err);
+  if (err) return err;
+  Symbol *sym = Workspace::lookup_existing_symbol (name);
+  if (!sym) return "No such variable.";
+  sym->assign (Z, false, LOC);
+  return NULL;
+}
+
+#define OUT_BUFSIZE (64 * 1024)
+
+typedef struct {
+  int    fd;
+  size_t used;
+  bool   ok;
+  char   buf[OUT_BUFSIZE];
+} out_buf_s;
+
+static void
+out_flush (out_buf_s &ob)
+{
+  size_t done = 0;
+  while (ob.ok && done < ob.used) {
+    ssize_t sz = write (ob.fd, ob.buf + done, ob.used - done);
+    if (sz < 0 && errno == EINTR) continue;
+    if (sz <= 0) ob.ok = false;
+    else done += sz;
+  }
+  ob.used = 0;
+}
+
+static void
+out_put (out_buf_s &ob, const char *p, size_t len)
+{
+  while (len > 0) {
+    if (ob.used == OUT_BUFSIZE) out_flush (ob);
+    size_t n = std::min (len, OUT_BUFSIZE - ob.used);
+    memcpy (ob.buf + ob.used, p, n);
+    ob.used += n;
+    p += n;
+    len -= n;
+  }
+}
+
+static void
+out_fill (out_buf_s &ob, char c, size_t cnt)
+{
+  while (cnt-- > 0) {
+    if (ob.used == OUT_BUFSIZE) out_flush (ob);
+    ob.buf[ob.used++] = c;
+  }
+}
+
+static size_t
+put_utf8 (char *buf, Unicode uni)
+{
+  unsigned int u = uni;
+  if (u < 0x80) { buf[0] = u; return 1; }
+  if (u < 0x800) {
+    buf[0] = 0xC0 | (u >> 6);
+    buf[1] = 0x80 | (u & 0x3F);
+    return 2;
+  }
+  if (u < 0x10000) {
+    buf[0] = 0xE0 | (u >> 12);
+    buf[1] = 0x80 | ((u >> 6) & 0x3F);
+    buf[2] = 0x80 | (u & 0x3F);
+    return 3;
+  }
+  buf[0] = 0xF0 | (u >> 18);
+  buf[1] = 0x80 | ((u >> 12) & 0x3F);
+  buf[2] = 0x80 | ((u >> 6) & 0x3F);
+  buf[3] = 0x80 | (u & 0x3F);
+  return 4;
+}
+
+/***
+    Turn C's -1.5e-05 into APL's ¯1.5E¯5.
+***/
+
+static size_t
+aplify (const char *p, const char *e, char *out)
+{
+  size_t n = 0;
+  bool in_exp = false;
+  bool exp_lead = false;
+  for (; p < e; p++) {
+    char c = *p;
+    if (c == '-') {
+      out[n++] = 0xC2;
+      out[n++] = 0xAF;
+    }
+    else if (c == 'e') {
+      out[n++] = 'E';
+      in_exp = exp_lead = true;
+    }
+    else if (in_exp && c == '+') ;
+    else if (exp_lead && c == '0' && p + 1 < e) ;
+    else {
+      out[n++] = c;
+      exp_lead = false;
+    }
+  }
+  return n;
+}
+
+/***
+    The shortest text that reads back as exactly val, whatever ⎕PP is:
+    a value saved unchanged must fix unchanged.
+***/
+
+static size_t
+format_real (char *buf, APL_Float val)
+{
+  char tmp[64];
+  std::to_chars_result res = std::to_chars (tmp, tmp + sizeof(tmp), val);
+  return aplify (tmp, res.ptr, buf);
+}
+
+/***
+    Format one numeric cell into buf (at least 128 bytes).  Returns the
+    byte count, or 0 if the cell isn't a number.
+***/
+
+static size_t
+format_cell (char *buf, const Cell &cell)
+{
+  if (cell.is_integer_cell ()) {
+    char tmp[32];
+    std::to_chars_result res =
+      std::to_chars (tmp, tmp + sizeof(tmp), cell.get_int_value ());
+    return aplify (tmp, res.ptr, buf);
+  }
+  if (cell.is_float_cell ())
+    return format_real (buf, cell.get_real_value ());
+  if (cell.is_complex_cell ()) {
+    size_t n = format_real (buf, cell.get_real_value ());
+    buf[n++] = 'J';
+    return n + format_real (buf + n, cell.get_imag_value ());
+  }
+  return 0;
+}
+
+/***
+    Display width of formatted text: ¯ is two bytes but one column.
+***/
+
+static size_t
+display_width (const char *buf, size_t len)
+{
+  size_t w = len;
+  for (size_t i = 0; i + 1 < len; i++)
+    if ((unsigned char)buf[i] == 0xC2 && (unsigned char)buf[i + 1] == 0xAF)
+      w--;
+  return w;
+}
+
+/***
+    Blank lines to put before row r: one for every axis, other than the
+    last two, that row r starts a new item of.  This is what APL shows
+    and what text_to_value() expects.
+***/
+
+static int
+plane_breaks (const Value &val, ShapeItem r)
+{
+  int blanks = 0;
+  ShapeItem p = 1;
+  for (int ax = val.get_rank () - 2; ax >= 1; ax--) {
+    p *= val.get_shape_item (ax);
+    if (p == 0 || r % p) break;
+    blanks++;
+  }
+  return blanks;
+}
+
+/***
+    Write a simple array to fd.  Numeric matrices and higher get their
+    columns right-aligned, which takes a first pass over the data to
+    find the widths; memory stays at one width per column.  Returns
+    NULL or what went wrong.
+***/
+
+static const char *
+write_value (int fd, const Value &val)
+{
+  ShapeItem count = val.element_count ();
+  uRank rank = val.get_rank ();
+  ShapeItem cols = rank ? val.get_shape_item (rank - 1) : 1;
+  if (val.is_empty () || cols == 0) return NULL;
+  ShapeItem rows = count / cols;
+  bool is_char = val.is_char_array ();
+  char cbuf[128];
+
+  std::vector<size_t> widths;
+  if (!is_char && rank >= 2) {
+    widths.resize (cols, 0);
+    loop (i, count) {
+      size_t n = format_cell (cbuf, val.get_ravel (i));
+      if (n == 0) return "Mixed arrays are not supported.";
+      size_t w = display_width (cbuf, n);
+      if (w > widths[i % cols]) widths[i % cols] = w;
+    }
+  }
+
+  out_buf_s *ob = new out_buf_s;
+  ob->fd   = fd;
+  ob->used = 0;
+  ob->ok   = true;
+  const char *err = NULL;
+  ShapeItem i = 0;
+  for (ShapeItem r = 0; r < rows && !err; r++) {
+    if (r > 0) out_fill (*ob, '\n', plane_breaks (val, r));
+    loop (c, cols) {
+      const Cell &cell = val.get_ravel (i++);
+      if (is_char) {
+	if (!cell.is_character_cell ()) {
+	  err = "Mixed arrays are not supported.";
+	  break;
+	}
+	out_put (*ob, cbuf, put_utf8 (cbuf, cell.get_char_value ()));
+      }
+      else {
+	size_t n = format_cell (cbuf, cell);
+	if (n == 0) {
+	  err = "Mixed arrays are not supported.";
+	  break;
+	}
+	if (c > 0) out_fill (*ob, ' ', 1);
+	if (!widths.empty ())
+	  out_fill (*ob, ' ', widths[c] - display_width (cbuf, n));
+	out_put (*ob, cbuf, n);
+      }
+    }
+    out_fill (*ob, '\n', 1);
+  }
+  out_flush (*ob);
+  if (!err && !ob->ok) err = "Error writing working file.";
+  delete ob;
+  return err;
+}
+
+/***
+    True for the arrays write_value() can handle: simple, and all
+    characters or all numbers.
+***/
+
+static bool
+is_plain (const Value &val)
+{
+  if (!val.is_simple ()) return false;
+  if (val.is_char_array ()) return true;
+  ShapeItem count = val.element_count ();
+  loop (i, count)
+    if (val.get_ravel (i).is_character_cell ()) return false;
+  return true;
+}
+
+static void
+put_indent (out_buf_s &ob, int depth)
+{
+  out_fill (ob, ' ', 2 * depth);
+}
+
+static void
+put_shape (out_buf_s &ob, const Value &val)
+{
+  char buf[32];
+  loop (r, val.get_rank ()) {
+    out_fill (ob, ' ', 1);
+    std::to_chars_result res =
+      std::to_chars (buf, buf + sizeof(buf), val.get_shape_item (r));
+    out_put (ob, buf, res.ptr - buf);
+  }
+}
+
+/***
+    A trailing blank is written as \s so that editors that strip
+    trailing white space can't change the item count.
+***/
+
+static void
+put_char (out_buf_s &ob, Unicode uni, bool last)
+{
+  char buf[8];
+  if (last && uni == ' ') {
+    out_put (ob, "\\s", 2);
+    return;
+  }
+  switch (uni) {
+  case '\n': out_put (ob, "\\n", 2);  break;
+  case '\r': out_put (ob, "\\r", 2);  break;
+  case '\\': out_put (ob, "\\\\", 2); break;
+  default:   out_put (ob, buf, put_utf8 (buf, uni)); break;
+  }
+}
+
+static void
+put_scalar (out_buf_s &ob, const Cell &cell, int depth)
+{
+  put_indent (ob, depth);
+  if (cell.is_character_cell ()) {
+    out_put (ob, "' : ", 4);
+    put_char (ob, cell.get_char_value (), true);
+  }
+  else {
+    char buf[128];
+    out_put (ob, "# : ", 4);
+    out_put (ob, buf, format_cell (buf, cell));
+  }
+  out_fill (ob, '\n', 1);
+}
+
+static void
+put_nested (out_buf_s &ob, const Value &val, int depth)
+{
+  ShapeItem count = val.element_count ();
+  put_indent (ob, depth);
+  if (is_plain (val)) {
+    bool is_char = count ? val.is_char_array ()
+                         : val.get_ravel (0).is_character_cell ();
+    out_put (ob, is_char ? "'" : "#", 1);
+    put_shape (ob, val);
+    out_put (ob, " :", 2);
+    char buf[128];
+    loop (i, count) {
+      const Cell &cell = val.get_ravel (i);
+      if (is_char) {
+	if (i == 0) out_fill (ob, ' ', 1);
+	put_char (ob, cell.get_char_value (), i == count - 1);
+      }
+      else {
+	out_fill (ob, ' ', 1);
+	out_put (ob, buf, format_cell (buf, cell));
+      }
+    }
+    out_fill (ob, '\n', 1);
+    return;
+  }
+
+  out_put (ob, "⊂", strlen ("⊂"));
+  put_shape (ob, val);
+  out_fill (ob, '\n', 1);
+  ShapeItem items = count ? count : 1;	// empty: just the prototype
+  loop (i, items) {
+    const Cell &cell = val.get_ravel (i);
+    if (cell.is_pointer_cell ())
+      put_nested (ob, *cell.get_pointer_value ().get (), depth + 1);
+    else put_scalar (ob, cell, depth + 1);
+  }
+}
+
+static const char *
+write_nested (int fd, const Value &val)
+{
+  out_buf_s *ob = new out_buf_s;
+  ob->fd   = fd;
+  ob->used = 0;
+  ob->ok   = true;
+  put_nested (*ob, val, 0);
+  out_flush (*ob);
+  const char *err = ob->ok ? NULL : "Error writing working file.";
+  delete ob;
+  return err;
+}
+
+typedef enum { ITEM_BAD, ITEM_NESTED, ITEM_NUMBERS, ITEM_CHARS } item_kind_e;
+
+/***
+    Pick apart one line: marker, shape and, for simple arrays, the
+    offset of the ravel text.
+***/
+
+static item_kind_e
+parse_item_head (const char *p, const char *e, Shape &shape, bool &scalar,
+		 const char *&data)
+{
+  while (p < e && *p == ' ') p++;
+  item_kind_e kind = ITEM_BAD;
+  size_t enc_len = strlen ("⊂");
+  if (p < e && *p == '#') { kind = ITEM_NUMBERS; p++; }
+  else if (p < e && *p == '\'') { kind = ITEM_CHARS; p++; }
+  else if ((size_t)(e - p) >= enc_len && !memcmp (p, "⊂", enc_len)) {
+    kind = ITEM_NESTED;
+    p += enc_len;
+  }
+  else return ITEM_BAD;
+
+  scalar = true;
+  while (p < e) {
+    while (p < e && *p == ' ') p++;
+    if (p == e) break;
+    if (*p == ':') {
+      if (kind == ITEM_NESTED) return ITEM_BAD;
+      p++;
+      if (p < e && *p == ' ') p++;
+      break;
+    }
+    ShapeItem len;
+    std::from_chars_result res = std::from_chars (p, e, len);
+    if (res.ec != std::errc () || len < 0) return ITEM_BAD;
+    shape.add_shape_item (len);
+    scalar = false;
+    p = res.ptr;
+  }
+  data = p;
+  return kind;
+}
+
+/***
+    Undo put_char()'s escapes, then decode.
+***/
+
+static UCS_string
+unescape_chars (const char *p, const char *e)
+{
+  std::string bytes;
+  bytes.reserve (e - p);
+  for (; p < e; p++) {
+    if (*p == '\\' && p + 1 < e) {
+      p++;
+      switch (*p) {
+      case 'n': bytes += '\n'; break;
+      case 'r': bytes += '\r'; break;
+      case 's': bytes += ' ';  break;
+      default:  bytes += *p;   break;
+      }
+    }
+    else bytes += *p;
+  }
+  UTF8_string utf (bytes.c_str ());
+  return UCS_string (utf);
+}
+
+static bool parse_nested_into (const std::string &text,
+			       const std::vector<text_line_s> &lines,
+			       size_t &ln, Value_P &parent, Value_P &item,
+			       const char *&err);
+
+/***
+    Parse the item starting at line ln.  If parent is set the item is
+    appended to its ravel -- simple scalars as plain cells, everything
+    else as a nested value; otherwise the item is returned in item.
+***/
+
+static bool
+parse_nested_into (const std::string &text,
+		   const std::vector<text_line_s> &lines,
+		   size_t &ln, Value_P &parent, Value_P &item,
+		   const char *&err)
+{
+  while (ln < lines.size () && lines[ln].len == 0) ln++;
+  if (ln >= lines.size ()) {
+    err = "Missing items.";
+    return false;
+  }
+  const char *p = text.data () + lines[ln].start;
+  const char *e = p + lines[ln].len;
+  ln++;
+
+  Shape shape;
+  bool scalar;
+  const char *data = e;
+  item_kind_e kind = parse_item_head (p, e, shape, scalar, data);
+  ShapeItem count = 1;
+  loop (r, shape.get_rank ()) count *= shape.get_shape_item (r);
+
+  switch (kind) {
+  case ITEM_NESTED:
+    {
+      Value_P Z (shape, LOC);
+      if (count == 0) {				// just the prototype
+	Value_P none;
+	Value_P proto;
+	if (!parse_nested_into (text, lines, ln, none, proto, err))
+	  return false;
+	if (proto->is_char_array ()) Z->set_default_Spc ();
+	else Z->set_default_Zero ();
+      }
+      else {
+	loop (i, count) {
+	  Value_P unused;
+	  if (!parse_nested_into (text, lines, ln, Z, unused, err))
+	    return false;
+	}
+      }
+      Z->check_value (LOC);
+      if (!!parent) parent->next_ravel_Pointer (Z.get ());
+      else item = Z;
+      return true;
+    }
+  case ITEM_NUMBERS:
+    {
+      std::vector<num_cell_s> cells;
+      while (data < e) {
+	while (data < e && is_blank (*data)) data++;
+	const char *tok = data;
+	while (data < e && !is_blank (*data)) data++;
+	if (data == tok) break;
+	num_cell_s cell;
+	if (!parse_number (tok, data - tok, cell)) {
+	  err = "Invalid number.";
+	  return false;
+	}
+	cells.push_back (cell);
+      }
+      if ((ShapeItem)cells.size () != count) {
+	err = "Item count doesn't match the shape.";
+	return false;
+      }
+      bool as_cell = scalar && !!parent;
+      Value_P Z;
+      if (!as_cell) Z = Value_P (shape, LOC);
+      Value *into = as_cell ? parent.get () : Z.get ();
+      for (const num_cell_s &cell : cells) {
+	switch (cell.kind) {
+	case num_cell_s::NUM_INT:     into->next_ravel_Int (cell.ival);	break;
+	case num_cell_s::NUM_FLOAT:   into->next_ravel_Float (cell.re);	break;
+	case num_cell_s::NUM_COMPLEX:
+	  into->next_ravel_Complex (cell.re, cell.im);
+	  break;
+	}
+      }
+      if (!as_cell) {
+	if (count == 0) Z->set_default_Zero ();
+	Z->check_value (LOC);
+	if (!!parent) parent->next_ravel_Pointer (Z.get ());
+	else item = Z;
+      }
+      return true;
+    }
+  case ITEM_CHARS:
+    {
+      UCS_string ucs = unescape_chars (data, e);
+      if ((ShapeItem)ucs.size () != count) {
+	err = "Item count doesn't match the shape.";
+	return false;
+      }
+      if (scalar && !!parent) {
+	parent->next_ravel_Char (ucs[0]);
+	return true;
+      }
+      Value_P Z (shape, LOC);
+      loop (i, count) Z->next_ravel_Char (ucs[i]);
+      if (count == 0) Z->set_default_Spc ();
+      Z->check_value (LOC);
+      if (!!parent) parent->next_ravel_Pointer (Z.get ());
+      else item = Z;
+      return true;
+    }
+  default:
+    err = "Unrecognised line.";
+    return false;
+  }
+}
+
+static Value_P
+nested_to_value (const std::string &text, const char *&err)
+{
+  err = NULL;
+  std::vector<text_line_s> lines;
+  split_lines (text, lines);
+  size_t ln = 0;
+  Value_P none;
+  Value_P Z;
+  if (!parse_nested_into (text, lines, ln, none, Z, err)) return Value_P ();
+  while (ln < lines.size () && lines[ln].len == 0) ln++;
+  if (ln < lines.size ()) {
+    err = "Extra lines after the value.";
+    return Value_P ();
+  }
+  return Z;
+}
+
+static const char *
+assign_nested_text (const UCS_string &name, const std::string &text)
+{
+  const char *err = NULL;
+  Value_P Z = nested_to_value (text, err);
+  if (err) return err;
+  Symbol *sym = Workspace::lookup_existing_symbol (name);
+  if (!sym) return "No such variable.";
+  sym->assign (Z, false, LOC);
+  return NULL;
+}
+
+#endif  // EDIF_VAR_HH
@@ -0,0 +1,12 @@
+/* The stand-in for GNU APL's config.h, which edif and edif2 include
+   for its version.  Like any autoconf header it has no include guard:
+   edif.cc includes it a second time after undefining these.  */
+
+#define PACKAGE "apl"
+#define PACKAGE_BUGREPORT "bug-apl@gnu.org"
+#define PACKAGE_NAME "GNU APL"
+#define PACKAGE_STRING "GNU APL stand-in"
+#define PACKAGE_TARNAME "apl"
+#define PACKAGE_URL ""
+#define PACKAGE_VERSION "stand-in"
+#define VERSION "stand-in"
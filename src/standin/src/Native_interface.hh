@@ -0,0 +1,329 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NATIVE_INTERFACE_HH
+#define NATIVE_INTERFACE_HH
+
+/***
+    A stand-in for the part of GNU APL's native interface that edif and
+    edif2 use, so both can be built, tested and benchmarked without an
+    interpreter; the implementation is in ../standin.cc.  Only what the
+    two libraries call is here, with the same names and signatures, and
+    it behaves the way edif relies on: values are reference counted
+    arrays of cells, a workspace holds named functions and variables,
+    UserFunction::fix() takes a header and body, and ⍎ knows )ERASE and
+    Command::do_APL_expression() knows NAME←{BODY}.  It is not an APL
+    interpreter; see standin.hh for what tests get on top.
+
+    The directory is laid out like a GNU APL source tree, so the
+    -I$(APL_SOURCES) -I$(APL_SOURCES)/src the libraries are built with
+    find this instead.
+***/
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+#define LOC __FILE__ ":" STR(__LINE__)
+#define loop(v, n) for (int64_t v = 0; v < (int64_t)(n); ++v)
+
+typedef int32_t Unicode;
+typedef unsigned char UTF8;
+typedef int64_t APL_Integer;
+typedef double APL_Float;
+typedef int64_t ShapeItem;
+typedef int uRank;
+typedef int sAxis;
+
+enum { UNI_LF = 10, UNI_SPACE = 32, UNI_MUE = 0x3bc };
+enum Fun_signature { SIG_NONE, SIG_Z_A_F2_B };
+enum Cause { CAUSE_SHUTDOWN, CAUSE_ERASED };
+enum TokenTag { TOK_APL_VALUE1 };
+enum NameClass {
+  NC_UNUSED_USER_NAME = 0,
+  NC_VARIABLE         = 2,
+  NC_FUNCTION         = 3,
+  NC_OPERATOR         = 4,
+  NC_case_mask        = 0xff,
+};
+enum PrintStyle { PST_NONE };
+
+class UCS_string;
+class Value;
+class NativeFunction;
+
+class UTF8_string : public std::basic_string<UTF8> {
+public:
+  UTF8_string ();
+  UTF8_string (const char *str);
+  UTF8_string (const UTF8 *str, size_t len);
+  UTF8_string (const UTF8_string &other);
+  UTF8_string (const UCS_string &ucs);
+  UTF8_string &operator= (const UTF8_string &other);
+  const char *c_str () const { return (const char *)data (); }
+};
+
+std::ostream &operator<< (std::ostream &out, const UTF8_string &utf);
+
+class UCS_string;
+typedef std::vector<UCS_string> UCS_string_vector;
+
+class UCS_string : public std::basic_string<Unicode> {
+public:
+  UCS_string ();
+  UCS_string (const UTF8_string &utf);
+  UCS_string (const UCS_string &other);
+  UCS_string (const UCS_string &other, size_t pos, size_t len);
+  UCS_string (size_t len, Unicode uni);
+  explicit UCS_string (const Value &val);
+  UCS_string &operator= (const UCS_string &other);
+
+  void append (const UCS_string &other);
+  void append (Unicode uni);
+  void append_UTF8 (const char *str);
+  void append_number (APL_Integer num);
+  bool has_black () const;
+  void to_vector (UCS_string_vector &lines) const;
+};
+
+std::ostream &operator<< (std::ostream &out, const UCS_string &ucs);
+
+class Shape {
+public:
+  Shape () {}
+  Shape (ShapeItem a) { add_shape_item (a); }
+  Shape (ShapeItem a, ShapeItem b) { add_shape_item (a); add_shape_item (b); }
+  void add_shape_item (ShapeItem a) { items.push_back (a); }
+  uRank get_rank () const { return (uRank)items.size (); }
+  ShapeItem get_shape_item (int r) const { return items[r]; }
+  ShapeItem get_volume () const;
+  bool operator== (const Shape &other) const { return items == other.items; }
+private:
+  std::vector<ShapeItem> items;
+};
+
+/***
+    A counted reference, as in GNU APL: a Value stays alive as long as a
+    Value_P or a pointer cell holds it.
+***/
+class Value_P {
+public:
+  Value_P () : val (NULL) {}
+  explicit Value_P (Value *v);
+  Value_P (const Value_P &other);
+  Value_P (const UCS_string &ucs, const char *loc);
+  Value_P (const Shape &shape, const char *loc);
+  Value_P (ShapeItem len, const char *loc);
+  ~Value_P ();
+  Value_P &operator= (const Value_P &other);
+  Value *operator-> () const { return val; }
+  Value &operator* () const { return *val; }
+  Value *get () const { return val; }
+  bool operator! () const { return val == NULL; }
+  void reset ();
+private:
+  Value *val;
+};
+
+class Cell {
+public:
+  Cell () : tag (CT_NONE), cval (0), ival (0), re (0), im (0) {}
+  bool is_pointer_cell () const;
+  bool is_character_cell () const;
+  bool is_integer_cell () const;
+  bool is_float_cell () const;
+  bool is_complex_cell () const;
+  Value_P get_pointer_value () const;
+  Unicode get_char_value () const;
+  APL_Integer get_int_value () const;
+  APL_Float get_real_value () const;
+  APL_Float get_imag_value () const;
+
+  enum {
+    CT_NONE, CT_CHAR, CT_INT, CT_FLOAT, CT_COMPLEX, CT_POINTER
+  } tag;
+  Unicode     cval;
+  APL_Integer ival;
+  APL_Float   re;
+  APL_Float   im;
+  Value_P     pval;
+};
+
+class Value {
+public:
+  Value (const Shape &sh, const char *loc);
+
+  bool is_char_string () const;
+  bool is_char_array () const;
+  bool is_simple () const;
+  bool is_empty () const;
+  bool is_numeric_scalar () const;
+  APL_Integer get_sole_integer () const;
+  UCS_string get_UCS_ravel () const;
+  void check_value (const char *loc);
+
+  const Shape &get_shape () const { return shape; }
+  uRank get_rank () const { return shape.get_rank (); }
+  ShapeItem get_shape_item (int r) const { return shape.get_shape_item (r); }
+  ShapeItem element_count () const { return shape.get_volume (); }
+  ShapeItem nz_element_count () const;
+  const Cell &get_ravel (ShapeItem i) const { return ravel[i]; }
+
+  Cell *next_ravel ();
+  void next_ravel_Int (APL_Integer ival);
+  void next_ravel_Float (APL_Float re);
+  void next_ravel_Char (Unicode uni);
+  void next_ravel_Complex (APL_Float re, APL_Float im);
+  void next_ravel_Pointer (Value *sub);
+  void set_default_Zero ();
+  void set_default_Spc ();
+
+  int owners;				// Value_P and pointer cells
+private:
+  Shape shape;
+  std::vector<Cell> ravel;		// at least one cell: the prototype
+  ShapeItem filled;
+};
+
+Value_P IntScalar (APL_Integer val, const char *loc);
+Value_P Str0_0 (const char *loc);
+Value_P Idx0 (const char *loc);
+
+class Token {
+public:
+  Token (TokenTag tag, Value_P val) : tag (tag), val (val) {}
+  TokenTag get_tag () const { return tag; }
+  Value_P get_apl_val () const { return val; }
+private:
+  TokenTag tag;
+  Value_P  val;
+};
+
+class UserFunction;
+
+class Function {
+public:
+  virtual ~Function () {}
+  virtual UCS_string canonical (bool with_lines) const = 0;
+  virtual bool is_lambda () const { return false; }
+  virtual const UserFunction *get_func_ufun () const { return NULL; }
+  const int *get_exec_properties () const;
+};
+
+class UserFunction : public Function {
+public:
+  static UserFunction *fix (const UCS_string &text, int &err_line,
+			    bool keep_existing, const char *loc,
+			    const UTF8_string &creator, bool tolerant);
+  UserFunction (const UCS_string &name, const UCS_string &text,
+		bool lambda, bool op);
+  virtual UCS_string canonical (bool with_lines) const;
+  virtual bool is_lambda () const { return lambda; }
+  virtual const UserFunction *get_func_ufun () const { return this; }
+  APL_Integer get_creation_time () const { return created; }
+  bool is_operator () const { return op; }
+  const UCS_string &get_name () const { return name; }
+private:
+  UCS_string  name;
+  UCS_string  text;			// lines, each ended by LF
+  bool        lambda;
+  bool        op;
+  APL_Integer created;
+};
+
+class NamedObject {
+public:
+  virtual ~NamedObject () {}
+  virtual bool is_user_defined () const { return true; }
+  virtual const Function *get_function () const { return NULL; }
+  virtual const UCS_string &get_name () const = 0;
+};
+
+class Symbol : public NamedObject {
+public:
+  Symbol (const UCS_string &name) : name (name), function (NULL) {}
+  ~Symbol ();
+  virtual const Function *get_function () const { return function; }
+  virtual const UCS_string &get_name () const { return name; }
+  Value *get_val_wptr () { return value.get (); }
+  void assign (Value_P val, bool clone, const char *loc);
+  void set_function (UserFunction *fun);
+  int get_NC () const;
+private:
+  UCS_string    name;
+  Value_P       value;
+  UserFunction *function;
+};
+
+class SymbolTable {
+public:
+  std::vector<const Symbol *> get_all_symbols () const;
+};
+
+class PrintContext {
+public:
+  PrintContext (int pp) : pp (pp) {}
+  int get_PP () const { return pp; }
+private:
+  int pp;
+};
+
+class Workspace {
+public:
+  static NamedObject *lookup_existing_name (const UCS_string &name);
+  static Symbol *lookup_existing_symbol (const UCS_string &name);
+  static Symbol *lookup_symbol (const UCS_string &name);
+  static PrintContext get_PrintContext (PrintStyle style);
+  static SymbolTable &get_symbol_table ();
+};
+
+class Macro : public Function {
+public:
+  enum Macro_num { MAC_COUNT = 0 };	// none in the stand-in
+  static const Macro *get_macro (Macro_num num);
+  const UCS_string &get_name () const;
+};
+
+class Command {
+public:
+  static void do_APL_expression (UCS_string &line);
+};
+
+class Bif_F1_EXECUTE {
+public:
+  static void execute_command (UCS_string &command);
+};
+
+class Quad_NC {
+public:
+  static APL_Integer get_NC (const UCS_string &name);
+};
+
+#endif  // NATIVE_INTERFACE_HH
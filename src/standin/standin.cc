@@ -0,0 +1,818 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    The stand-in GNU APL: just enough of an interpreter for edif and
+    edif2 to run against.  See src/Native_interface.hh and standin.hh.
+***/
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <set>
+
+#include "Native_interface.hh"
+#include "standin.hh"
+
+using namespace std;
+
+static pthread_t apl_thread;
+static bool apl_thread_set = false;
+static atomic<APL_Integer> foreign_uses (0);
+static APL_Integer fixes = 0;
+static APL_Integer canonicals = 0;
+static APL_Integer fix_clock = 0;
+static standin_fix_hook fix_hook = NULL;
+
+/***
+    The interpreter thread is whichever uses the stand-in first, which
+    is main() during static initialisation.
+***/
+
+static void
+note_thread ()
+{
+  if (!apl_thread_set) {
+    apl_thread = pthread_self ();
+    apl_thread_set = true;
+  }
+  else if (!pthread_equal (apl_thread, pthread_self ())) foreign_uses++;
+}
+
+static map<UCS_string, Symbol *> &
+symbols ()
+{
+  static map<UCS_string, Symbol *> table;
+  return table;
+}
+
+static set<UCS_string> &
+pendent ()
+{
+  static set<UCS_string> names;
+  return names;
+}
+
+// ---------------------------------------------------------------- strings
+
+UTF8_string::UTF8_string () { note_thread (); }
+
+UTF8_string::UTF8_string (const char *str)
+  : basic_string<UTF8> ((const UTF8 *)str) { note_thread (); }
+
+UTF8_string::UTF8_string (const UTF8 *str, size_t len)
+  : basic_string<UTF8> (str, len) { note_thread (); }
+
+UTF8_string::UTF8_string (const UTF8_string &other)
+  : basic_string<UTF8> (other) { note_thread (); }
+
+UTF8_string::UTF8_string (const UCS_string &ucs)
+{
+  note_thread ();
+  for (Unicode uni : ucs) {
+    uint32_t cp = uni;
+    if (cp < 0x80) push_back (cp);
+    else if (cp < 0x800) {
+      push_back (0xc0 | (cp >> 6));
+      push_back (0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000) {
+      push_back (0xe0 | (cp >> 12));
+      push_back (0x80 | ((cp >> 6) & 0x3f));
+      push_back (0x80 | (cp & 0x3f));
+    }
+    else {
+      push_back (0xf0 | (cp >> 18));
+      push_back (0x80 | ((cp >> 12) & 0x3f));
+      push_back (0x80 | ((cp >> 6) & 0x3f));
+      push_back (0x80 | (cp & 0x3f));
+    }
+  }
+}
+
+UTF8_string &
+UTF8_string::operator= (const UTF8_string &other)
+{
+  basic_string<UTF8>::operator= (other);
+  return *this;
+}
+
+ostream &
+operator<< (ostream &out, const UTF8_string &utf)
+{
+  return out.write (utf.c_str (), utf.size ());
+}
+
+UCS_string::UCS_string () { note_thread (); }
+
+/***
+    Plain UTF-8 decoding; whatever is malformed is taken a byte at a
+    time, as Latin-1.
+***/
+
+UCS_string::UCS_string (const UTF8_string &utf)
+{
+  note_thread ();
+  size_t i = 0;
+  while (i < utf.size ()) {
+    unsigned char c = utf[i];
+    size_t n = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : 0;
+    uint32_t cp = n ? (c & (0x3f >> n)) : c;
+    bool ok = (i + n < utf.size ());
+    for (size_t k = 1; ok && k <= n; k++) {
+      if ((utf[i + k] & 0xc0) != 0x80) ok = false;
+      else cp = (cp << 6) | (utf[i + k] & 0x3f);
+    }
+    if (!ok) {
+      cp = c;
+      n = 0;
+    }
+    push_back ((Unicode)cp);
+    i += n + 1;
+  }
+}
+
+UCS_string::UCS_string (const UCS_string &other)
+  : basic_string<Unicode> (other) { note_thread (); }
+
+UCS_string::UCS_string (const UCS_string &other, size_t pos, size_t len)
+  : basic_string<Unicode> (other, pos < other.size () ? pos : other.size (),
+			   len)
+{
+  note_thread ();
+}
+
+UCS_string::UCS_string (size_t len, Unicode uni)
+  : basic_string<Unicode> (len, uni) { note_thread (); }
+
+UCS_string::UCS_string (const Value &val)
+{
+  note_thread ();
+  loop (i, val.element_count ())
+    if (val.get_ravel (i).is_character_cell ())
+      push_back (val.get_ravel (i).get_char_value ());
+}
+
+UCS_string &
+UCS_string::operator= (const UCS_string &other)
+{
+  basic_string<Unicode>::operator= (other);
+  return *this;
+}
+
+void
+UCS_string::append (const UCS_string &other)
+{
+  basic_string<Unicode>::append (other);
+}
+
+void
+UCS_string::append (Unicode uni)
+{
+  push_back (uni);
+}
+
+void
+UCS_string::append_UTF8 (const char *str)
+{
+  append (UCS_string (UTF8_string (str)));
+}
+
+void
+UCS_string::append_number (APL_Integer num)
+{
+  append_UTF8 (to_string (num).c_str ());
+}
+
+bool
+UCS_string::has_black () const
+{
+  for (Unicode uni : *this)
+    if (uni > UNI_SPACE) return true;
+  return false;
+}
+
+/***
+    As GNU APL does it: split at LF, a last line without one kept only
+    if it is not empty.
+***/
+
+void
+UCS_string::to_vector (UCS_string_vector &lines) const
+{
+  lines.clear ();
+  UCS_string line;
+  for (Unicode uni : *this) {
+    if (uni == UNI_LF) {
+      lines.push_back (line);
+      line.clear ();
+    }
+    else line.push_back (uni);
+  }
+  if (line.size ()) lines.push_back (line);
+}
+
+ostream &
+operator<< (ostream &out, const UCS_string &ucs)
+{
+  return out << UTF8_string (ucs);
+}
+
+// ----------------------------------------------------------------- values
+
+ShapeItem
+Shape::get_volume () const
+{
+  ShapeItem vol = 1;
+  for (ShapeItem a : items) vol *= a;
+  return vol;
+}
+
+Value_P::Value_P (Value *v) : val (v)
+{
+  if (val) val->owners++;
+}
+
+Value_P::Value_P (const Value_P &other) : val (other.val)
+{
+  if (val) val->owners++;
+}
+
+Value_P::Value_P (const UCS_string &ucs, const char *loc)
+  : val (new Value (Shape ((ShapeItem)ucs.size ()), loc))
+{
+  val->owners++;
+  for (Unicode uni : ucs) val->next_ravel_Char (uni);
+  if (ucs.empty ()) val->set_default_Spc ();
+}
+
+Value_P::Value_P (const Shape &shape, const char *loc)
+  : val (new Value (shape, loc))
+{
+  val->owners++;
+}
+
+Value_P::Value_P (ShapeItem len, const char *loc)
+  : val (new Value (Shape (len), loc))
+{
+  val->owners++;
+}
+
+Value_P::~Value_P ()
+{
+  reset ();
+}
+
+Value_P &
+Value_P::operator= (const Value_P &other)
+{
+  if (other.val) other.val->owners++;
+  reset ();
+  val = other.val;
+  return *this;
+}
+
+void
+Value_P::reset ()
+{
+  if (val && --val->owners == 0) delete val;
+  val = NULL;
+}
+
+bool Cell::is_pointer_cell ()   const { return tag == CT_POINTER; }
+bool Cell::is_character_cell () const { return tag == CT_CHAR; }
+bool Cell::is_integer_cell ()   const { return tag == CT_INT; }
+bool Cell::is_float_cell ()     const { return tag == CT_FLOAT; }
+bool Cell::is_complex_cell ()   const { return tag == CT_COMPLEX; }
+Value_P Cell::get_pointer_value () const { return pval; }
+Unicode Cell::get_char_value ()    const { return cval; }
+APL_Integer Cell::get_int_value () const { return ival; }
+APL_Float Cell::get_real_value ()  const { return re; }
+APL_Float Cell::get_imag_value ()  const { return im; }
+
+Value::Value (const Shape &sh, const char *loc)
+  : owners (0), shape (sh), filled (0)
+{
+  note_thread ();
+  ravel.resize (nz_element_count ());
+}
+
+ShapeItem
+Value::nz_element_count () const
+{
+  ShapeItem cnt = element_count ();
+  return cnt ? cnt : 1;
+}
+
+bool
+Value::is_char_string () const
+{
+  return get_rank () <= 1 && is_char_array ();
+}
+
+bool
+Value::is_char_array () const
+{
+  loop (i, nz_element_count ())
+    if (!ravel[i].is_character_cell ()) return false;
+  return true;
+}
+
+bool
+Value::is_simple () const
+{
+  loop (i, element_count ())
+    if (ravel[i].is_pointer_cell ()) return false;
+  return true;
+}
+
+bool
+Value::is_empty () const
+{
+  return element_count () == 0;
+}
+
+bool
+Value::is_numeric_scalar () const
+{
+  return get_rank () == 0 &&
+    (ravel[0].is_integer_cell () || ravel[0].is_float_cell ());
+}
+
+APL_Integer
+Value::get_sole_integer () const
+{
+  const Cell &cell = ravel[0];
+  if (cell.is_float_cell ()) return (APL_Integer)cell.get_real_value ();
+  return cell.get_int_value ();
+}
+
+UCS_string
+Value::get_UCS_ravel () const
+{
+  return UCS_string (*this);
+}
+
+/***
+    GNU APL complains about values that were never filled in; so does
+    the stand-in, loudly, since that is a bug in edif.
+***/
+
+void
+Value::check_value (const char *loc)
+{
+  if (filled < element_count ()) {
+    cerr << loc << ": value with " << element_count () << " items has only "
+	 << filled << " set" << endl;
+    abort ();
+  }
+  if (element_count () == 0 && ravel[0].tag == Cell::CT_NONE)
+    set_default_Zero ();
+}
+
+Cell *
+Value::next_ravel ()
+{
+  if (filled >= nz_element_count ()) {
+    cerr << "stand-in: more items than the value has room for" << endl;
+    abort ();
+  }
+  return &ravel[filled++];
+}
+
+void
+Value::next_ravel_Int (APL_Integer ival)
+{
+  Cell *cell = next_ravel ();
+  cell->tag = Cell::CT_INT;
+  cell->ival = ival;
+}
+
+void
+Value::next_ravel_Float (APL_Float re)
+{
+  Cell *cell = next_ravel ();
+  cell->tag = Cell::CT_FLOAT;
+  cell->re = re;
+}
+
+void
+Value::next_ravel_Char (Unicode uni)
+{
+  Cell *cell = next_ravel ();
+  cell->tag = Cell::CT_CHAR;
+  cell->cval = uni;
+}
+
+void
+Value::next_ravel_Complex (APL_Float re, APL_Float im)
+{
+  Cell *cell = next_ravel ();
+  cell->tag = Cell::CT_COMPLEX;
+  cell->re = re;
+  cell->im = im;
+}
+
+void
+Value::next_ravel_Pointer (Value *sub)
+{
+  Cell *cell = next_ravel ();
+  cell->tag = Cell::CT_POINTER;
+  cell->pval = Value_P (sub);
+}
+
+void
+Value::set_default_Zero ()
+{
+  if (element_count ()) return;
+  ravel[0] = Cell ();
+  ravel[0].tag = Cell::CT_INT;
+}
+
+void
+Value::set_default_Spc ()
+{
+  if (element_count ()) return;
+  ravel[0] = Cell ();
+  ravel[0].tag = Cell::CT_CHAR;
+  ravel[0].cval = UNI_SPACE;
+}
+
+Value_P
+IntScalar (APL_Integer val, const char *loc)
+{
+  Value_P Z (Shape (), loc);
+  Z->next_ravel_Int (val);
+  return Z;
+}
+
+Value_P
+Str0_0 (const char *loc)
+{
+  Value_P Z ((ShapeItem)0, loc);
+  Z->set_default_Spc ();
+  return Z;
+}
+
+Value_P
+Idx0 (const char *loc)
+{
+  Value_P Z ((ShapeItem)0, loc);
+  Z->set_default_Zero ();
+  return Z;
+}
+
+// -------------------------------------------------------------- functions
+
+const int *
+Function::get_exec_properties () const
+{
+  static const int props[4] = { 0, 0, 0, 0 };
+  return props;
+}
+
+UserFunction::UserFunction (const UCS_string &name, const UCS_string &text,
+			    bool lambda, bool op)
+  : name (name), text (text), lambda (lambda), op (op),
+    created (++fix_clock)
+{
+}
+
+UCS_string
+UserFunction::canonical (bool with_lines) const
+{
+  canonicals++;
+  return text;
+}
+
+static bool
+name_start (Unicode uni)
+{
+  return (uni >= 'A' && uni <= 'Z') || (uni >= 'a' && uni <= 'z') ||
+    uni == 0x2206 || uni == 0x2359;			// ∆ ⍙
+}
+
+static bool
+name_char (Unicode uni)
+{
+  return name_start (uni) || (uni >= '0' && uni <= '9') || uni == '_' ||
+    uni == 0xaf;					// ¯
+}
+
+static bool
+valid_name (const UCS_string &name)
+{
+  if (name.empty () || !name_start (name[0])) return false;
+  for (Unicode uni : name) if (!name_char (uni)) return false;
+  return true;
+}
+
+static UCS_string
+trimmed (const UCS_string &ucs)
+{
+  size_t b = 0;
+  size_t e = ucs.size ();
+  while (b < e && ucs[b] <= UNI_SPACE) b++;
+  while (e > b && ucs[e - 1] <= UNI_SPACE) e--;
+  return UCS_string (ucs, b, e - b);
+}
+
+/***
+    The name a header defines: [Z←] [A] F [B] or [Z←] [A] (LO OP [RO]) B,
+    with any locals after ';'.  Empty if the header makes no sense.
+***/
+
+static UCS_string
+header_name (const UCS_string &header, bool &op)
+{
+  op = false;
+  UCS_string h (header, 0, header.find (';'));
+  size_t arrow = h.find (0x2190);			// ←
+  if (arrow != string::npos) h = UCS_string (h, arrow + 1, string::npos);
+  size_t open = h.find ('(');
+  if (open != string::npos) {
+    op = true;
+    h = UCS_string (h, open + 1, h.find (')') - open - 1);
+  }
+  vector<UCS_string> words;
+  UCS_string word;
+  for (Unicode uni : h) {
+    if (uni == '{' || uni == '}') continue;
+    if (uni == '[') break;				// an axis
+    if (uni <= UNI_SPACE) {
+      if (word.size ()) words.push_back (word);
+      word.clear ();
+    }
+    else word.push_back (uni);
+  }
+  if (word.size ()) words.push_back (word);
+  UCS_string name;
+  if (op) {
+    if (words.size () >= 2) name = words[1];
+  }
+  else if (words.size () == 1 || words.size () == 2) name = words[0];
+  else if (words.size () == 3) name = words[1];
+  return valid_name (name) ? name : UCS_string ();
+}
+
+static void
+define (const UCS_string &name, UserFunction *fun)
+{
+  Workspace::lookup_symbol (name)->set_function (fun);
+  fixes++;
+  if (fix_hook) fix_hook (fun);
+}
+
+/***
+    The text is kept as given, every line ended by LF; it only has to
+    start with a header naming something that is not a variable and not
+    pendent.
+***/
+
+UserFunction *
+UserFunction::fix (const UCS_string &text, int &err_line, bool keep_existing,
+		   const char *loc, const UTF8_string &creator, bool tolerant)
+{
+  note_thread ();
+  err_line = 0;
+  UCS_string_vector lines;
+  text.to_vector (lines);
+  while (lines.size () && !lines.back ().has_black ()) lines.pop_back ();
+  if (lines.empty ()) return NULL;
+  bool op;
+  UCS_string name = header_name (lines[0], op);
+  if (name.empty ()) return NULL;
+  if (pendent ().count (name)) return NULL;
+  Symbol *sym = Workspace::lookup_existing_symbol (name);
+  if (sym && sym->get_val_wptr ()) return NULL;
+  if (sym && sym->get_function () && keep_existing) return NULL;
+
+  UCS_string body;
+  for (const UCS_string &line : lines) {
+    body.append (line);
+    body.append ((Unicode)UNI_LF);
+  }
+  UserFunction *fun = new UserFunction (name, body, false, op);
+  define (name, fun);
+  return fun;
+}
+
+Symbol::~Symbol ()
+{
+  delete function;
+}
+
+void
+Symbol::assign (Value_P val, bool clone, const char *loc)
+{
+  delete function;
+  function = NULL;
+  value = val;
+}
+
+void
+Symbol::set_function (UserFunction *fun)
+{
+  value.reset ();
+  delete function;
+  function = fun;
+}
+
+int
+Symbol::get_NC () const
+{
+  if (!!value) return NC_VARIABLE;
+  if (function) return function->is_operator () ? NC_OPERATOR : NC_FUNCTION;
+  return NC_UNUSED_USER_NAME;
+}
+
+vector<const Symbol *>
+SymbolTable::get_all_symbols () const
+{
+  vector<const Symbol *> all;
+  for (auto &s : symbols ()) all.push_back (s.second);
+  return all;
+}
+
+// -------------------------------------------------------------- workspace
+
+NamedObject *
+Workspace::lookup_existing_name (const UCS_string &name)
+{
+  return lookup_existing_symbol (name);
+}
+
+Symbol *
+Workspace::lookup_existing_symbol (const UCS_string &name)
+{
+  auto it = symbols ().find (name);
+  if (it == symbols ().end ()) return NULL;
+  return it->second->get_NC () ? it->second : NULL;
+}
+
+Symbol *
+Workspace::lookup_symbol (const UCS_string &name)
+{
+  Symbol *&sym = symbols ()[name];
+  if (!sym) sym = new Symbol (name);
+  return sym;
+}
+
+PrintContext
+Workspace::get_PrintContext (PrintStyle style)
+{
+  return PrintContext (10);
+}
+
+SymbolTable &
+Workspace::get_symbol_table ()
+{
+  static SymbolTable table;
+  return table;
+}
+
+const Macro *
+Macro::get_macro (Macro_num num)
+{
+  return NULL;
+}
+
+const UCS_string &
+Macro::get_name () const
+{
+  static const UCS_string none;
+  return none;
+}
+
+/***
+    ⍎ knows )ERASE and nothing else.
+***/
+
+void
+Bif_F1_EXECUTE::execute_command (UCS_string &command)
+{
+  UCS_string erase (UTF8_string (")ERASE "));
+  if (command.compare (0, erase.size (), erase) != 0) {
+    cerr << "stand-in cannot execute " << command << endl;
+    return;
+  }
+  UCS_string name;
+  for (size_t i = erase.size (); i <= command.size (); i++) {
+    if (i == command.size () || command[i] <= UNI_SPACE) {
+      auto it = symbols ().find (name);
+      if (it != symbols ().end ()) {
+	delete it->second;
+	symbols ().erase (it);
+      }
+      name.clear ();
+    }
+    else name.push_back (command[i]);
+  }
+}
+
+/***
+    NAME←{BODY} makes a lambda, canonically
+	λ←NAME ⍵
+	λ←BODY
+    as GNU APL shows it; anything else is beyond the stand-in.
+***/
+
+void
+Command::do_APL_expression (UCS_string &line)
+{
+  note_thread ();
+  size_t arrow = line.find (0x2190);			// ←
+  size_t open = line.find ('{');
+  size_t close = line.rfind ('}');
+  UCS_string name = (arrow == string::npos) ? UCS_string ()
+    : trimmed (UCS_string (line, 0, arrow));
+  if (!valid_name (name) || open == string::npos || close == string::npos ||
+      open < arrow || close < open ||
+      trimmed (UCS_string (line, arrow + 1, open - arrow - 1)).size () ||
+      trimmed (UCS_string (line, close + 1, string::npos)).size ()) {
+    cerr << "stand-in cannot evaluate " << line << endl;
+    return;
+  }
+  if (pendent ().count (name)) return;
+  Symbol *sym = Workspace::lookup_existing_symbol (name);
+  if (sym && sym->get_val_wptr ()) return;
+
+  UCS_string text (UTF8_string ("λ←"));
+  text.append (name);
+  text.append (UCS_string (UTF8_string (" ⍵\nλ←")));
+  text.append (trimmed (UCS_string (line, open + 1, close - open - 1)));
+  text.append ((Unicode)UNI_LF);
+  define (name, new UserFunction (name, text, true, false));
+}
+
+APL_Integer
+Quad_NC::get_NC (const UCS_string &name)
+{
+  UCS_string nm = trimmed (name);
+  if (!valid_name (nm)) return -1;
+  auto it = symbols ().find (nm);
+  return (it == symbols ().end ()) ? NC_UNUSED_USER_NAME
+    : it->second->get_NC ();
+}
+
+// ------------------------------------------------------------ for testing
+
+void
+standin_reset ()
+{
+  for (auto &s : symbols ()) delete s.second;
+  symbols ().clear ();
+  pendent ().clear ();
+}
+
+APL_Integer
+standin_fixes ()
+{
+  return fixes;
+}
+
+APL_Integer
+standin_canonicals ()
+{
+  return canonicals;
+}
+
+APL_Integer
+standin_foreign_uses ()
+{
+  return foreign_uses;
+}
+
+void
+standin_on_fix (standin_fix_hook hook)
+{
+  fix_hook = hook;
+}
+
+void
+standin_pendent (const UCS_string &name, bool is_pendent)
+{
+  if (is_pendent) pendent ().insert (name);
+  else pendent ().erase (name);
+}
@@ -0,0 +1,47 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STANDIN_HH
+#define STANDIN_HH
+
+/***
+    What tests and benchmarks get from the stand-in on top of the GNU
+    APL surface in src/Native_interface.hh: a way to empty the
+    workspace, to see every fix as it happens, to make a function
+    pendent so fixing it fails, a count of canonical() calls -- what
+    rendering a function costs in GNU APL -- and a count of GNU APL
+    strings and values made on some thread other than the
+    interpreter's -- the thread that first used the stand-in -- which
+    edif2 must never do.
+***/
+
+#include "Native_interface.hh"
+
+typedef void (*standin_fix_hook) (const UserFunction *fun);
+
+void standin_reset ();
+APL_Integer standin_fixes ();
+APL_Integer standin_canonicals ();
+APL_Integer standin_foreign_uses ();
+void standin_on_fix (standin_fix_hook hook);
+void standin_pendent (const UCS_string &name, bool pendent);
+
+#endif  // STANDIN_HH
@@ -0,0 +1,392 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    Timings for edif2's pipeline against the stand-in: exporting a
+    workspace of 2000 twenty-line functions, cold, unchanged and with a
+    few of them changed, and the round trip from saving a file to the
+    function being fixed, with no debounce and the interpreter side
+    asking for saves as fast as it can.
+
+    Opening a function of 10000 lines: writing its working file from
+    scratch, as for a function just fixed, against writing it from
+    render_cache, and against rendering it every time and writing it
+    through an ofstream, as edif2 did before the cache.  The stand-in's
+    canonical() only copies the text it was fixed with, where GNU APL's
+    builds it afresh, so the cache saves more there than it does here.
+
+    Startup: what ⎕fx of edif2 costs now that the session waits for the
+    first edit, against setting it up there and then as edif2 used to,
+    and what that first edit costs, session, editor and all.
+
+    For comparison, the same round trip the way edif2 used to do it,
+    rebuilt here: a forked child reading inotify and passing names on
+    through a POSIX message queue, whose mq_notify() signal has the
+    interpreter take them off the queue; and what starting that child
+    cost against starting the watcher thread, for a small process and
+    one with a large heap.
+***/
+
+#include <mqueue.h>
+#include <sys/mman.h>
+
+#include "edif2.cc"
+#include "harness.hh"
+
+static const char *prog = "edif2_bench";
+
+static Token
+edif2 (APL_Integer idx, const string &arg)
+{
+  return eval_XB (IntScalar (idx, LOC), harness_str (arg));
+}
+
+static string
+long_fn (int n, int lines, int version)
+{
+  string text = "z←f" + to_string (n) + " x\nz←x\n";
+  for (int l = 0; l < lines; l++)
+    text += "z←z+" + to_string (l) + "×x*" + to_string (version) + "\n";
+  return text;
+}
+
+static void
+report_ms (const char *what, uint64_t ns, size_t items)
+{
+  printf ("%s: %-34s %9.2f ms  %9.0f/s\n", prog, what, ns / 1e6,
+	  items * 1e9 / (ns ? ns : 1));
+}
+
+static void
+bench_export (const string &scratch)
+{
+  const int count = 2000;
+  standin_reset ();
+  for (int i = 0; i < count; i++) harness_fix (long_fn (i, 20, 1));
+  string to = scratch + "/export";
+
+  uint64_t start = harness_ns ();
+  edif2 (8, to);
+  report_ms ("export, cold", harness_ns () - start, count);
+
+  start = harness_ns ();
+  edif2 (8, to);
+  report_ms ("export, unchanged", harness_ns () - start, count);
+
+  for (int i = 0; i < count; i += 100) harness_fix (long_fn (i, 20, 2));
+  start = harness_ns ();
+  edif2 (8, to);
+  report_ms ("export, 1% changed", harness_ns () - start, count);
+}
+
+static void
+report_open (const char *what, vector<uint64_t> &ns, size_t bytes)
+{
+  double med = harness_percentile (ns, 50);
+  printf ("%s: %-34s %9.1f us  %7.1f MB/s  (median)\n", prog, what,
+	  med / 1e3, bytes * 1e3 / (med ? med : 1));
+}
+
+static void
+bench_open ()
+{
+  const int rounds = 20;
+  standin_reset ();
+  start_session ();
+  UCS_string name = harness_ucs ("f0");
+  string fn = string (dir) + "/f0" + APL_SUFFIX;
+  vector<uint64_t> cold, cached, uncached;
+  size_t bytes = 0;
+  for (int r = 0; r < rounds; r++) {
+    harness_fix (long_fn (0, 10000, r));	// a new function every round
+    uint64_t start = harness_ns ();
+    free (get_fcn (fn.c_str (), "f0", name));
+    cold.push_back (harness_ns () - start);
+
+    start = harness_ns ();
+    free (get_fcn (fn.c_str (), "f0", name));
+    cached.push_back (harness_ns () - start);
+
+    start = harness_ns ();
+    vector<u32string> lines;
+    ucs_lines (real_get_fcn (name)->canonical (false), lines);
+    string text = render_lines (lines, "f0", false);
+    ofstream tfile;
+    tfile.open (fn, ios::out);
+    tfile << text;
+    tfile.flush ();
+    tfile.close ();
+    uncached.push_back (harness_ns () - start);
+    bytes = text.size ();
+  }
+  report_open ("open 10000 lines, cold", cold, bytes);
+  report_open ("open 10000 lines, cached", cached, bytes);
+  report_open ("open 10000 lines, as before", uncached, bytes);
+  close_fun (CAUSE_SHUTDOWN, NULL);
+}
+
+static void
+report_latency (const char *what, vector<uint64_t> &lat)
+{
+  uint64_t p50 = harness_percentile (lat, 50);
+  uint64_t p99 = harness_percentile (lat, 99);
+  uint64_t max = harness_percentile (lat, 100);
+  printf ("%s: %-34s p50 %7.1f us  p99 %7.1f us  max %7.1f us  (%zu)\n",
+	  prog, what, p50 / 1e3, p99 / 1e3, max / 1e3, lat.size ());
+}
+
+static void
+bench_save_to_fix (const string &editor)
+{
+  const int rounds = 500;
+  standin_reset ();
+  harness_fix (long_fn (0, 20, 0));
+  eval_XB (IntScalar (5, LOC), IntScalar (0, LOC));	// no debounce
+  eval_AXB (harness_str (editor), IntScalar (0, LOC), harness_str ("f0"));
+  reg_entry_s *re = reg_find ("f0");
+  if (!re) {
+    printf ("%s: could not open f0\n", prog);
+    return;
+  }
+  string path = re->path;
+  vector<uint64_t> lat;
+  for (int r = 1; r <= rounds; r++) {
+    string text = long_fn (0, 20, r);
+    APL_Integer fixes = standin_fixes ();
+    uint64_t start = harness_ns ();
+    harness_write (path, text);
+    uint64_t give_up = start + 1000000000ULL;
+    while (standin_fixes () == fixes && harness_ns () < give_up)
+      edif2 (6, "");
+    if (standin_fixes () != fixes) lat.push_back (harness_ns () - start);
+  }
+  report_latency ("save to fix, function", lat);
+  close_fun (CAUSE_SHUTDOWN, NULL);
+}
+
+static double
+median_us (vector<uint64_t> &ns)
+{
+  return harness_percentile (ns, 50) / 1e3;
+}
+
+static void
+bench_startup (const string &editor)
+{
+  const int rounds = 50;
+  vector<uint64_t> lazy, eager, first;
+  standin_reset ();
+  harness_fix (long_fn (0, 20, 0));
+  for (int r = 0; r < rounds; r++) {
+    close_fun (CAUSE_SHUTDOWN, NULL);
+    uint64_t start = harness_ns ();
+    get_signature ();
+    lazy.push_back (harness_ns () - start);
+
+    close_fun (CAUSE_SHUTDOWN, NULL);
+    start = harness_ns ();
+    get_signature ();
+    start_session ();
+    eager.push_back (harness_ns () - start);
+
+    close_fun (CAUSE_SHUTDOWN, NULL);
+    get_signature ();
+    start = harness_ns ();
+    eval_AXB (harness_str (editor), IntScalar (0, LOC), harness_str ("f0"));
+    first.push_back (harness_ns () - start);
+  }
+  close_fun (CAUSE_SHUTDOWN, NULL);
+  get_signature ();
+  printf ("%s: %-34s %9.1f us  eager %9.1f us  (median)\n", prog,
+	  "startup, lazy", median_us (lazy), median_us (eager));
+  printf ("%s: %-34s %9.1f us  (median)\n", prog,
+	  "first edit, session included", median_us (first));
+}
+
+/***
+    The old path.  The signal handler only takes the name off the queue
+    and re-arms the notification, as handle_msg() did, so the fix itself
+    is the same check_file() the new path ends in.
+***/
+
+#define HOP_SIGNAL (SIGRTMAX - 2)
+static mqd_t hop_mqd = (mqd_t)-1;
+static volatile sig_atomic_t hop_got = 0;
+
+static bool
+hop_notify ()
+{
+  struct sigevent sevp;
+  memset (&sevp, 0, sizeof(sevp));
+  sevp.sigev_notify = SIGEV_SIGNAL;
+  sevp.sigev_signo  = HOP_SIGNAL;
+  return mq_notify (hop_mqd, &sevp) == 0;
+}
+
+static void
+hop_handler (int sig, siginfo_t *si, void *data)
+{
+  char bfr[NAME_MAX + 8];
+  struct timespec ts = { 0, 10000 };
+  while (0 <= mq_timedreceive (hop_mqd, bfr, sizeof(bfr), NULL, &ts))
+    hop_got = 1;
+  hop_notify ();
+}
+
+static void
+hop_child (const string &where)
+{
+  int inotify_fd = inotify_init ();
+  inotify_add_watch (inotify_fd, where.c_str (), IN_CLOSE_WRITE);
+  while (1) {
+    char buf[BUF_LEN] __attribute__ ((aligned(8)));
+    ssize_t sz = read (inotify_fd, buf, BUF_LEN);
+    if (sz <= 0) continue;
+    struct inotify_event *event = (struct inotify_event *)buf;
+    if (event->len > 0 && strlen (event->name) > 0)
+      while (mq_send (hop_mqd, event->name, event->len, 0) == -1 &&
+	     (errno == EINTR || errno == EAGAIN)) ;
+  }
+}
+
+static void
+bench_old_hop (const string &scratch)
+{
+  const int rounds = 500;
+  string where = scratch + "/hop";
+  mkdir (where.c_str (), 0700);
+  string path = where + "/f0.apl";
+  string mq_name = "/edif2_bench_" + to_string (getpid ());
+  struct mq_attr attr;
+  memset (&attr, 0, sizeof(attr));
+  attr.mq_maxmsg  = 8;
+  attr.mq_msgsize = NAME_MAX + 1;
+  mq_unlink (mq_name.c_str ());
+  hop_mqd = mq_open (mq_name.c_str (), O_RDWR | O_CREAT | O_NONBLOCK | O_EXCL,
+		     0600, &attr);
+  if (hop_mqd == (mqd_t)-1) {
+    printf ("%s: save to fix, fork+mq: skipped, mq_open: %s\n", prog,
+	    strerror (errno));
+    return;
+  }
+  struct sigaction act, old_act;
+  memset (&act, 0, sizeof(act));
+  act.sa_sigaction = hop_handler;
+  sigemptyset (&act.sa_mask);
+  act.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigaction (HOP_SIGNAL, &act, &old_act);
+  hop_notify ();
+
+  pid_t pid = fork ();
+  if (pid == 0) hop_child (where);
+  harness_sleep_ms (50);			// let it add its watch
+
+  standin_reset ();
+  harness_fix (long_fn (0, 20, 0));
+  vector<uint64_t> lat;
+  for (int r = 1; r <= rounds; r++) {
+    string text = long_fn (0, 20, r);
+    APL_Integer fixes = standin_fixes ();
+    hop_got = 0;
+    uint64_t start = harness_ns ();
+    harness_write (path, text);
+    uint64_t give_up = start + 1000000000ULL;
+    while (!hop_got && harness_ns () < give_up) ;
+    if (hop_got) check_file ("f0", path.c_str (), 0);
+    if (standin_fixes () != fixes) lat.push_back (harness_ns () - start);
+  }
+  report_latency ("save to fix, fork+mq (old)", lat);
+
+  kill (pid, SIGKILL);
+  waitpid (pid, NULL, 0);
+  sigaction (HOP_SIGNAL, &old_act, NULL);
+  mq_close (hop_mqd);
+  mq_unlink (mq_name.c_str ());
+  hop_mqd = (mqd_t)-1;
+}
+
+static void *
+idle_thread (void *arg)
+{
+  return NULL;
+}
+
+/***
+    What it costs the interpreter to start a watcher: fork() copies the
+    page tables of everything it has touched, a thread copies nothing.
+***/
+
+static void
+bench_watcher_start (size_t heap_mb)
+{
+  const int rounds = 20;
+  size_t len = heap_mb << 20;
+  char *heap = NULL;
+  if (len) {
+    heap = (char *)mmap (NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (heap == MAP_FAILED) {
+      printf ("%s: watcher start, %zu MB heap: skipped\n", prog, heap_mb);
+      return;
+    }
+    memset (heap, 1, len);
+  }
+  vector<uint64_t> forks, threads;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = harness_ns ();
+    pid_t pid = fork ();
+    if (pid == 0) _exit (0);
+    forks.push_back (harness_ns () - start);
+    waitpid (pid, NULL, 0);
+
+    pthread_t th;
+    start = harness_ns ();
+    pthread_create (&th, NULL, idle_thread, NULL);
+    threads.push_back (harness_ns () - start);
+    pthread_join (th, NULL);
+  }
+  string what = "watcher start, " + to_string (heap_mb) + " MB heap";
+  printf ("%s: %-34s fork %8.1f us  thread %6.1f us  (median)\n", prog,
+	  what.c_str (), harness_percentile (forks, 50) / 1e3,
+	  harness_percentile (threads, 50) / 1e3);
+  if (heap) munmap (heap, len);
+}
+
+int
+main (int argc, char **argv)
+{
+  string editor = harness_editor (argc, argv);
+  harness_need_session_dir (prog);
+  string scratch = harness_scratch (prog);
+  get_signature ();
+
+  bench_export (scratch);
+  bench_open ();
+  bench_startup (editor);
+  bench_save_to_fix (editor);
+  bench_old_hop (scratch);
+  bench_watcher_start (0);
+  bench_watcher_start (1024);
+
+  close_fun (CAUSE_SHUTDOWN, NULL);
+  harness_remove (scratch);
+  return 0;
+}
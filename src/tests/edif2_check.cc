@@ -0,0 +1,623 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    edif2's export, watch, read and fix pipeline, run against the
+    stand-in: functions are exported and re-exported, opened in a
+    stand-in editor, saved from outside and fixed at the next edif2
+    call, and finally close_fun() has to leave no editor behind.
+    When libedif.so has been built, edif is loaded alongside, as it can
+    be in GNU APL, to see that edif2 going idle leaves edif working.
+***/
+
+#include <dlfcn.h>
+
+#include "edif2.cc"
+#include "harness.hh"
+
+static const char *prog = "edif2_check";
+static string scratch;
+
+static Token
+edif2 (APL_Integer idx, const string &arg)
+{
+  return eval_XB (IntScalar (idx, LOC), harness_str (arg));
+}
+
+/***
+    Keep making edif2 calls, as a user at the keyboard would, until
+    done() or two seconds have gone by.  Returns the saves applied.
+***/
+
+template <typename F>
+static int
+settle (F done)
+{
+  int applied = 0;
+  uint64_t give_up = harness_ns () + 2000000000ULL;
+  while (harness_ns () < give_up) {
+    applied += harness_int (edif2 (6, ""));
+    if (done ()) break;
+    harness_sleep_ms (1);
+  }
+  return applied;
+}
+
+static string
+fn_text (int n, const char *op)
+{
+  return "z←f" + to_string (n) + " x\nz←x" + op + to_string (n) + "\n";
+}
+
+static void
+check_export ()
+{
+  standin_reset ();
+  for (int i = 0; i < 200; i++) CHECK (harness_fix (fn_text (i, "+")));
+  UCS_string lambda (UTF8_string ("g←{⍵+1}"));
+  Command::do_APL_expression (lambda);
+  string to = scratch + "/export";
+
+  Token Z = edif2 (8, to);
+  CHECK (harness_int (Z, 0) == 201);
+  CHECK (harness_int (Z, 1) == 0);
+  CHECK (harness_read (to + "/f7.apl") == fn_text (7, "+"));
+  CHECK (harness_read (to + "/_lambda_g.apl") == "g←{⍵+1}\n");
+  CHECK (standin_foreign_uses () == 0);
+
+  Z = edif2 (8, to);
+  CHECK (harness_int (Z, 0) == 0);
+  CHECK (harness_int (Z, 1) == 201);
+
+  CHECK (harness_fix (fn_text (7, "×")));
+  Z = edif2 (8, to);
+  CHECK (harness_int (Z, 0) == 1);
+  CHECK (harness_int (Z, 1) == 200);
+  CHECK (harness_read (to + "/f7.apl") == fn_text (7, "×"));
+  CHECK (standin_foreign_uses () == 0);
+
+  // erased: f199's file goes, f198's stays as it was edited on disk
+  CHECK (harness_write (to + "/f198.apl", fn_text (198, "-")));
+  CHECK (harness_write (to + "/notes.apl", "not exported\n"));
+  UCS_string erase (UTF8_string (")ERASE f198 f199"));
+  Bif_F1_EXECUTE::execute_command (erase);
+  Z = edif2 (8, to);
+  CHECK (harness_int (Z, 0) == 0);
+  CHECK (harness_int (Z, 1) == 199);
+  CHECK (harness_int (Z, 2) == 1);
+  struct stat sb;
+  CHECK (stat ((to + "/f199.apl").c_str (), &sb) != 0);
+  CHECK (harness_read (to + "/f198.apl") == fn_text (198, "-"));
+  CHECK (harness_read (to + "/notes.apl") == "not exported\n");
+}
+
+static void
+check_function (const string &editor)
+{
+  Token Z = eval_AXB (harness_str (editor), IntScalar (0, LOC),
+		      harness_str ("f7"));
+  CHECK (harness_text (Z) == "");
+  reg_entry_s *re = reg_find ("f7");
+  CHECK (re != NULL);
+  if (!re) return;
+  string path = re->path;
+  CHECK (re->editor > 0);
+  CHECK (harness_read (path) == fn_text (7, "×"));
+
+  APL_Integer fixes = standin_fixes ();
+  CHECK (harness_write (path, fn_text (7, "-")));
+  settle ([] { return harness_canonical ("f7") == fn_text (7, "-"); });
+  CHECK (harness_canonical ("f7") == fn_text (7, "-"));
+  CHECK (standin_fixes () == fixes + 1);
+  re = reg_find ("f7");
+  CHECK (re && re->fix == FIX_OK);
+
+  // the same bytes again: nothing to fix
+  APL_Integer skips = counters[CNT_HASH_SKIPS] + counters[CNT_CANON_SKIPS];
+  harness_sleep_ms (10);
+  CHECK (harness_write (path, fn_text (7, "-")));
+  settle ([&] {
+    return counters[CNT_HASH_SKIPS] + counters[CNT_CANON_SKIPS] > skips;
+  });
+  CHECK (counters[CNT_HASH_SKIPS] + counters[CNT_CANON_SKIPS] == skips + 1);
+  CHECK (standin_fixes () == fixes + 1);
+
+  // a pendent function will not fix; the same text saved again will
+  standin_pendent (harness_ucs ("f7"), true);
+  APL_Integer failed = counters[CNT_FAILED];
+  CHECK (harness_write (path, fn_text (7, "÷")));
+  settle ([&] { return counters[CNT_FAILED] > failed; });
+  CHECK (counters[CNT_FAILED] == failed + 1);
+  CHECK (harness_canonical ("f7") == fn_text (7, "-"));
+  re = reg_find ("f7");
+  CHECK (re && re->fix == FIX_FAILED);
+
+  standin_pendent (harness_ucs ("f7"), false);
+  harness_sleep_ms (10);
+  CHECK (harness_write (path, fn_text (7, "÷")));
+  settle ([] { return harness_canonical ("f7") == fn_text (7, "÷"); });
+  CHECK (harness_canonical ("f7") == fn_text (7, "÷"));
+}
+
+static void
+check_new_function ()
+{
+  CHECK (harness_text (edif2 (0, "h")) == "");
+  reg_entry_s *re = reg_find ("h");
+  CHECK (re != NULL);
+  if (!re) return;
+  CHECK (harness_read (re->path) == "h\n");
+  CHECK (harness_write (re->path, "z←h\nz←42\n"));
+  settle ([] { return harness_canonical ("h") != ""; });
+  CHECK (harness_canonical ("h") == "z←h\nz←42\n");
+}
+
+/***
+    Reopening a function that hasn't been fixed since must write its
+    working file from render_cache, without canonical(); one fixed in
+    between must be rendered again.  Saves still pending are taken
+    first, so nothing else renders while it is counted.
+***/
+
+static void
+check_reopen ()
+{
+  CHECK (harness_fix (fn_text (900, "+")));
+  CHECK (harness_text (edif2 (0, "f900")) == "");
+  reg_entry_s *re = reg_find ("f900");
+  CHECK (re != NULL);
+  if (!re) return;
+  string path = re->path;
+
+  harness_sleep_ms (20);
+  edif2 (6, "");
+  APL_Integer renders = standin_canonicals ();
+  unlink (path.c_str ());
+  CHECK (harness_text (edif2 (0, "f900")) == "");
+  CHECK (standin_canonicals () == renders);
+  CHECK (harness_read (path) == fn_text (900, "+"));
+
+  CHECK (harness_fix (fn_text (900, "×")));
+  harness_sleep_ms (20);
+  edif2 (6, "");
+  renders = standin_canonicals ();
+  CHECK (harness_text (edif2 (0, "f900")) == "");
+  CHECK (standin_canonicals () == renders + 1);
+  CHECK (harness_read (path) == fn_text (900, "×"));
+}
+
+/***
+    Reverting a function that is open puts the old text in its working
+    file as well, and saving the newer text from the editor again fixes
+    it again rather than being skipped as already seen.
+***/
+
+static void
+check_revert ()
+{
+  CHECK (harness_fix (fn_text (901, "+")));
+  CHECK (harness_text (edif2 (0, "f901")) == "");
+  reg_entry_s *re = reg_find ("f901");
+  CHECK (re != NULL);
+  if (!re) return;
+  string path = re->path;
+  CHECK (harness_write (path, fn_text (901, "×")));
+  settle ([] { return harness_canonical ("f901") == fn_text (901, "×"); });
+  CHECK (harness_canonical ("f901") == fn_text (901, "×"));
+
+  CHECK (harness_int (edif2 (16, "f901")) == 1);
+  CHECK (harness_canonical ("f901") == fn_text (901, "+"));
+  CHECK (harness_read (path) == fn_text (901, "+"));
+  APL_Integer fixes = standin_fixes ();
+  harness_sleep_ms (20);
+  edif2 (6, "");
+  CHECK (standin_fixes () == fixes);		// its own write is no save
+
+  CHECK (harness_write (path, fn_text (901, "×")));
+  settle ([] { return harness_canonical ("f901") == fn_text (901, "×"); });
+  CHECK (harness_canonical ("f901") == fn_text (901, "×"));
+}
+
+static void
+check_lambda ()
+{
+  CHECK (harness_text (edif2 (0, "g")) == "");
+  reg_entry_s *re = reg_find ("g");
+  CHECK (re != NULL);
+  if (!re) return;
+  CHECK (re->lambda);
+  CHECK (harness_read (re->path) == "g←{⍵+1}\n");
+  CHECK (harness_write (re->path, "g←{⍵×2}\n"));
+  settle ([] { return harness_canonical ("g") == "λ←g ⍵\nλ←⍵×2\n"; });
+  CHECK (harness_canonical ("g") == "λ←g ⍵\nλ←⍵×2\n");
+}
+
+static void
+check_variable ()
+{
+  Value_P V (Shape (2, 3), LOC);
+  loop (i, 6) V->next_ravel_Int (i + 1);
+  V->check_value (LOC);
+  Workspace::lookup_symbol (harness_ucs ("v"))->assign (V, false, LOC);
+
+  CHECK (harness_text (edif2 (0, "v")) == "");
+  reg_entry_s *re = reg_find ("v");
+  CHECK (re != NULL);
+  if (!re) return;
+  CHECK (re->variable);
+  CHECK (harness_read (re->path) == "1 2 3\n4 5 6\n");
+  CHECK (harness_write (re->path, "7 8 9\n10 11 12\n"));
+  Symbol *sym = Workspace::lookup_existing_symbol (harness_ucs ("v"));
+  settle ([&] {
+    Value *val = sym->get_val_wptr ();
+    return val && val->get_ravel (0).get_int_value () == 7;
+  });
+  Value *val = sym->get_val_wptr ();
+  CHECK (val && val->get_shape () == Shape (2, 3));
+  if (val) loop (i, 6) CHECK (val->get_ravel (i).get_int_value () == 7 + i);
+}
+
+/***
+    A save as an editor makes it is a burst: a swap file, a probe file,
+    a backup, the file written in place in two goes, then renamed over
+    once more.  Each burst must come to exactly one fix, of the last
+    text, however many events it raised.  Events from the checks before
+    are let through first, so that they aren't counted with the bursts.
+***/
+
+static string
+burst_text (int k)
+{
+  return "z←f7 x\nz←x×" + to_string (100 + k) + "\n";
+}
+
+static void
+check_bursts ()
+{
+  const int saves = 10;
+  reg_entry_s *re = reg_find ("f7");
+  CHECK (re != NULL);
+  if (!re) return;
+  string path = re->path;
+  string where = path.substr (0, path.rfind ('/') + 1);
+  APL_Integer seen;
+  do {
+    seen = counters[CNT_INOTIFY];
+    harness_sleep_ms (50);
+    edif2 (6, "");
+  } while (counters[CNT_INOTIFY] != seen);
+  eval_XB (IntScalar (5, LOC), IntScalar (20, LOC));
+  APL_Integer inotify = counters[CNT_INOTIFY];
+  APL_Integer events = counters[CNT_EVENTS];
+  APL_Integer merged = counters[CNT_MERGED];
+  APL_Integer fixes = standin_fixes ();
+  for (int k = 0; k < saves; k++) {
+    string text = burst_text (k);
+    CHECK (harness_write (where + ".f7.apl.swp", "swap"));
+    CHECK (harness_write (where + "4913", ""));
+    CHECK (harness_write (where + "f7.apl~", burst_text (k - 1)));
+    CHECK (harness_write (path, text.substr (0, 8)));
+    CHECK (harness_write (path, text));
+    CHECK (harness_write (where + ".f7.tmp", text));
+    CHECK (rename ((where + ".f7.tmp").c_str (), path.c_str ()) == 0);
+    settle ([&] { return harness_canonical ("f7") == text; });
+    CHECK (harness_canonical ("f7") == text);
+    harness_sleep_ms (40);
+    edif2 (6, "");
+  }
+  unlink ((where + ".f7.apl.swp").c_str ());
+  unlink ((where + "4913").c_str ());
+  unlink ((where + "f7.apl~").c_str ());
+  inotify = counters[CNT_INOTIFY] - inotify;
+  events = counters[CNT_EVENTS] - events;
+  merged = counters[CNT_MERGED] - merged;
+  fixes = standin_fixes () - fixes;
+  printf ("%s: %d saves in bursts: %lld inotify events, %lld handed on, "
+	  "%lld merged, %lld fixes\n", prog, saves, (long long)inotify,
+	  (long long)events, (long long)merged, (long long)fixes);
+  CHECK (inotify >= 6 * saves);
+  CHECK (events == saves);
+  CHECK (fixes == saves);
+  eval_XB (IntScalar (5, LOC), IntScalar (5, LOC));
+}
+
+/***
+    Save n files of a mirrored tree at once, from first on, and return
+    how many fixes and rescans that took.  The tree must go quiet only
+    once, so the debounce is widened while they are written.
+***/
+
+static void
+mirror_save (const string &tree, int first, int n, APL_Integer &fixes,
+	     APL_Integer &rescans, APL_Integer &dropped)
+{
+  eval_XB (IntScalar (5, LOC), IntScalar (50, LOC));
+  APL_Integer inotify = counters[CNT_INOTIFY];
+  rescans = counters[CNT_RESCANS];
+  dropped = counters[CNT_DROPPED];
+  fixes = standin_fixes ();
+  for (int i = first; i < first + n; i++)
+    CHECK (harness_write (tree + "/m" + to_string (i) + ".apl",
+			  "z←m" + to_string (i) + " x\nz←x+1\n"));
+  settle ([&] { return standin_fixes () - fixes >= n; });
+  harness_sleep_ms (100);
+  edif2 (6, "");
+  inotify = counters[CNT_INOTIFY] - inotify;
+  rescans = counters[CNT_RESCANS] - rescans;
+  dropped = counters[CNT_DROPPED] - dropped;
+  fixes = standin_fixes () - fixes;
+  printf ("%s: %d mirrored files saved: %lld inotify events, %lld fixes, "
+	  "%lld rescans\n", prog, n, (long long)inotify, (long long)fixes,
+	  (long long)rescans);
+  eval_XB (IntScalar (5, LOC), IntScalar (5, LOC));
+}
+
+/***
+    Fifty files in a mirrored tree saved at once come in a few reads of
+    the inotify descriptor, and each goes through the ring to be fixed,
+    once.  Six hundred, more than the ring holds, are a checkout: one
+    rescan, nothing dropped, and again each changed file fixed once and
+    the rest left alone.
+***/
+
+static void
+check_mirror_burst ()
+{
+  const int count = 700, few = 50, many = 600;
+  string tree = scratch + "/mirror";
+  mkdir (tree.c_str (), 0700);
+  for (int i = 0; i < count; i++)
+    CHECK (harness_write (tree + "/m" + to_string (i) + ".apl",
+			  "z←m" + to_string (i) + " x\nz←x\n"));
+  CHECK (harness_int (edif2 (9, tree)) == count);
+
+  APL_Integer fixes, rescans, dropped;
+  mirror_save (tree, 0, few, fixes, rescans, dropped);
+  CHECK (fixes == few);
+  CHECK (rescans == 0);
+  CHECK (harness_canonical ("m49") == "z←m49 x\nz←x+1\n");
+
+  mirror_save (tree, few, many, fixes, rescans, dropped);
+  CHECK (fixes == many);
+  CHECK (rescans == 1);
+  CHECK (dropped == 0);
+  for (int i = few; i < few + many; i++)
+    CHECK (harness_canonical ("m" + to_string (i))
+	   == "z←m" + to_string (i) + " x\nz←x+1\n");
+  CHECK (harness_canonical ("m650") == "z←m650 x\nz←x\n");
+  edif2 (9, "");
+}
+
+/***
+    close_fun() kills the editors and must reap them before it returns.
+***/
+
+static void
+check_close ()
+{
+  vector<pid_t> pids;
+  for (auto &e : editors) pids.push_back (e.first);
+  CHECK (pids.size () == 8);
+  string where = dir ? dir : "";
+  close_fun (CAUSE_SHUTDOWN, NULL);
+  CHECK (!watch_running);
+  for (pid_t pid : pids) {
+    int wstatus;
+    CHECK (waitpid (pid, &wstatus, WNOHANG) == -1 && errno == ECHILD);
+  }
+  struct stat sb;
+  CHECK (where != "" && stat (where.c_str (), &sb) != 0);
+}
+
+/***
+    The percentiles in edif2 [12] are exact, not histogram bounds: runs
+    of 1 to 100 milliseconds have a median of 50 and a 99th of 99, where
+    the buckets would say 65.536 and 131.072.
+***/
+
+static void
+check_metrics ()
+{
+  edif2 (14, "");
+  for (int ms = 100; ms >= 1; ms--)
+    stage_note (STG_LOOKUP, now_ns () - ms * 1000000ULL);
+  Token Z = edif2 (12, "");
+  CHECK (harness_int (Z, 1) == 100);
+  APL_Integer p50 = harness_int (Z, 4), p99 = harness_int (Z, 5);
+  CHECK (p50 >= 50000 && p50 < 50100);
+  CHECK (p99 >= 99000 && p99 < 99100);
+}
+
+/***
+    A trace dumped to the default place lands in /var/run/user/<uid>,
+    and a symbolic link found there is not followed.
+***/
+
+static void
+check_trace_dump ()
+{
+  string path = "/var/run/user/" + to_string (getuid ()) + "/edif2."
+    + to_string (getpid ()) + ".trace";
+  unlink (path.c_str ());
+  CHECK (trace_dump (NULL) > 0);
+  CHECK (harness_read (path).find (" fix ") != string::npos);
+  unlink (path.c_str ());
+
+  string target = scratch + "/trace-target";
+  CHECK (harness_write (target, "untouched\n"));
+  CHECK (symlink (target.c_str (), path.c_str ()) == 0);
+  CHECK (trace_dump (NULL) == -1);
+  CHECK (harness_read (target) == "untouched\n");
+  unlink (path.c_str ());
+}
+
+/***
+    Twice as many files saved at once as the ring has slots, with the
+    interpreter too busy to take any: the watcher drops what doesn't
+    fit and asks for a rescan.  Every changed file must still be fixed,
+    each exactly once, and the files saved unchanged, or not saved at
+    all, skipped.
+***/
+
+static map<string, int> fixed_names;
+
+static void
+note_fix (const UserFunction *fun)
+{
+  UTF8_string utf (fun->get_name ());
+  fixed_names[string (utf.c_str (), utf.size ())]++;
+}
+
+static void
+check_overflow (const string &editor)
+{
+  const int count = 2 * RING_SLOTS, same = 25, changed = count - 2 * same;
+  for (int i = 0; i < count; i++)
+    CHECK (harness_fix (fn_text (1000 + i, "+")));
+  Token Z = eval_AXB (harness_str (editor), IntScalar (0, LOC),
+		      harness_str ("f1???"));
+  CHECK (harness_text (Z) == "");
+  vector<string> paths;
+  for (int i = 0; i < count; i++) {
+    reg_entry_s *re = reg_find (("f" + to_string (1000 + i)).c_str ());
+    CHECK (re != NULL);
+    if (!re) return;
+    paths.push_back (re->path);
+  }
+
+  APL_Integer dropped = counters[CNT_DROPPED];
+  APL_Integer rescans = counters[CNT_RESCANS];
+  APL_Integer fixes = standin_fixes ();
+  fixed_names.clear ();
+  standin_on_fix (note_fix);
+  harness_sleep_ms (10);
+  for (int i = 0; i < changed + same; i++)
+    CHECK (harness_write (paths[i],
+			  fn_text (1000 + i, i < changed ? "×" : "+")));
+  harness_sleep_ms (100);		// the watcher fills the ring meanwhile
+  settle ([&] { return standin_fixes () - fixes >= changed; });
+  harness_sleep_ms (50);
+  edif2 (6, "");
+  standin_on_fix (NULL);
+  dropped = counters[CNT_DROPPED] - dropped;
+  rescans = counters[CNT_RESCANS] - rescans;
+  fixes = standin_fixes () - fixes;
+  printf ("%s: %d files saved past the ring: %lld dropped, %lld rescans, "
+	  "%lld fixes\n", prog, changed + same, (long long)dropped,
+	  (long long)rescans, (long long)fixes);
+  CHECK (dropped > 0);
+  CHECK (rescans > 0);
+  CHECK (fixes == changed);
+  CHECK (fixed_names.size () == (size_t)changed);
+  for (int i = 0; i < changed; i++) {
+    string name = "f" + to_string (1000 + i);
+    CHECK (fixed_names[name] == 1);
+    CHECK (harness_canonical (name) == fn_text (1000 + i, "×"));
+  }
+  close_fun (CAUSE_SHUTDOWN, NULL);
+}
+
+/***
+    edif and edif2 share /var/run/user/<uid>/<pid>, which edif makes
+    only when it is loaded.  An edif2 session that has gone idle must
+    leave it there for edif's next edit, here with an editor that exits
+    at once, leaving the function as it was.
+***/
+
+typedef Fun_signature (*signature_fun) ();
+typedef Token (*eval_AB_fun) (Value_P A, Value_P B,
+			      const NativeFunction *caller);
+typedef bool (*close_fun_fun) (Cause cause, const NativeFunction *caller);
+
+static void
+check_edif_after_idle (const string &editor)
+{
+  /***
+      The program exports edif2's get_signature() as well as the
+      stand-in, so edif has to be bound to its own first.
+  ***/
+  void *h = dlopen ("./.libs/libedif.so",
+		    RTLD_NOW | RTLD_LOCAL | RTLD_DEEPBIND);
+  if (!h) {
+    printf ("%s: edif after edif2: skipped, %s\n", prog, dlerror ());
+    return;
+  }
+  void *(*mux) (const char *) =
+    (void *(*) (const char *))dlsym (h, "get_function_mux");
+  CHECK (mux != NULL);
+  if (!mux) { dlclose (h); return; }
+  signature_fun edif_signature = (signature_fun)mux ("get_signature");
+  eval_AB_fun edif_AB = (eval_AB_fun)mux ("eval_AB");
+  close_fun_fun edif_close = (close_fun_fun)mux ("close_fun");
+  edif_signature ();
+
+  CHECK (harness_fix (fn_text (800, "+")));
+  Token Z = eval_AXB (harness_str (editor), IntScalar (0, LOC),
+		      harness_str ("f800"));
+  CHECK (harness_text (Z) == "");
+  CHECK (watch_running);
+  reg_entry_s *re = reg_find ("f800");
+  CHECK (re != NULL);
+  if (!re) { dlclose (h); return; }
+  string path = re->path;
+  kill (re->editor, SIGTERM);
+  settle ([] { return !watch_running; });
+  CHECK (!watch_running);
+  struct stat sb;
+  CHECK (stat (path.c_str (), &sb) != 0);	// edif2's own file is gone
+
+  Z = edif_AB (harness_str ("true"), harness_str ("f800"), NULL);
+  CHECK (harness_text (Z) == "");
+  CHECK (harness_canonical ("f800") == fn_text (800, "+"));
+
+  edif_close (CAUSE_SHUTDOWN, NULL);
+  close_fun (CAUSE_SHUTDOWN, NULL);
+  dlclose (h);
+}
+
+int
+main (int argc, char **argv)
+{
+  string editor = harness_editor (argc, argv);
+  harness_need_session_dir (prog);
+  scratch = harness_scratch (prog);
+  get_signature ();
+  edif2 (5, "");				// see that [5] takes a number
+  eval_XB (IntScalar (5, LOC), IntScalar (5, LOC));	// 5 ms debounce
+
+  check_export ();
+  check_function (editor);
+  check_new_function ();
+  check_reopen ();
+  check_revert ();
+  check_lambda ();
+  check_variable ();
+  check_bursts ();
+  check_mirror_burst ();
+  check_close ();
+  check_metrics ();
+  check_trace_dump ();
+  check_overflow (editor);
+  check_edif_after_idle (editor);
+
+  harness_remove (scratch);
+  return harness_done (prog);
+}
@@ -0,0 +1,223 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    A storm of saves against edif2 and the stand-in:
+
+      edif2_storm [editors [saves/s [seconds [debounce ms]]]]
+
+    opens one function per editor, 16 by default, and has a thread for
+    each save its file at the given rate, 50 a second, for 3 seconds,
+    the way an editor does, to a temporary file renamed over the old
+    one.  Each save carries a sequence number and the time it was
+    made, so when the stand-in fixes it the storm knows exactly which
+    save that was and how long it took.  Meanwhile the interpreter
+    side makes an edif2 call every millisecond.
+
+    It reports the exact 50th and 99th percentiles and the longest
+    time from a save to its fix; saves merged into a later one before
+    they were read, which is what the debounce is for; saves fixed
+    twice; and saves lost, whose file's last save was never fixed.
+    Either of the last two is a failure.
+***/
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "edif2.cc"
+#include "harness.hh"
+
+static const char *prog = "edif2_storm";
+
+typedef struct {
+  string               name;
+  string               path;
+  double               rate;
+  double               seconds;
+  APL_Integer          last_seq;	// writer's
+  APL_Integer          fixed_seq;	// interpreter's
+  pthread_t            thread;
+} storm_file_s;
+
+static vector<storm_file_s> files;
+static vector<uint64_t> latencies;
+static APL_Integer storm_merged = 0;
+static APL_Integer storm_duplicates = 0;
+
+static Token
+edif2 (APL_Integer idx, const string &arg)
+{
+  return eval_XB (IntScalar (idx, LOC), harness_str (arg));
+}
+
+static string
+save_text (const string &name, APL_Integer seq, uint64_t ns)
+{
+  return "z←" + name + " x\nz←x+" + to_string (seq) + "\n⍝ "
+    + to_string (ns) + "\n";
+}
+
+/***
+    Called by the stand-in for every fix, on the interpreter thread.
+***/
+
+static void
+on_fix (const UserFunction *fun)
+{
+  uint64_t now = harness_ns ();
+  UTF8_string utf (fun->canonical (false));
+  string text (utf.c_str (), utf.size ());
+  static const string head = "z←s", body = "z←x+", mark = "⍝ ";
+  size_t at = text.find (body);
+  size_t when = text.find (mark);
+  if (text.compare (0, head.size (), head) || at == string::npos
+      || when == string::npos)
+    return;
+  size_t f = strtoul (text.c_str () + head.size (), NULL, 10);
+  if (f >= files.size ()) return;
+  APL_Integer seq = strtoll (text.c_str () + at + body.size (), NULL, 10);
+  uint64_t ns = strtoull (text.c_str () + when + mark.size (), NULL, 10);
+
+  storm_file_s &sf = files[f];
+  if (seq <= sf.fixed_seq) {
+    storm_duplicates++;
+    return;
+  }
+  storm_merged += seq - sf.fixed_seq - 1;
+  sf.fixed_seq = seq;
+  latencies.push_back (now - ns);
+}
+
+static void *
+editor_thread (void *arg)
+{
+  storm_file_s &sf = *(storm_file_s *)arg;
+  size_t slash = sf.path.rfind ('/');
+  string tmp = sf.path.substr (0, slash + 1) + "." + sf.name + ".tmp";
+  uint64_t period = (uint64_t)(1e9 / sf.rate);
+  uint64_t start = harness_ns ();
+  uint64_t stop = start + (uint64_t)(sf.seconds * 1e9);
+  APL_Integer seq = 0;
+  for (uint64_t next = start; next < stop; next += period) {
+    uint64_t now = harness_ns ();
+    if (next > now) {
+      struct timespec ts = { (time_t)((next - now) / 1000000000ULL),
+			     (long)((next - now) % 1000000000ULL) };
+      nanosleep (&ts, NULL);
+    }
+    seq++;
+    if (harness_write (tmp, save_text (sf.name, seq, harness_ns ())) &&
+	rename (tmp.c_str (), sf.path.c_str ()) == 0)
+      __atomic_store_n (&sf.last_seq, seq, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+static bool
+caught_up ()
+{
+  for (storm_file_s &sf : files)
+    if (sf.fixed_seq != __atomic_load_n (&sf.last_seq, __ATOMIC_ACQUIRE))
+      return false;
+  return true;
+}
+
+int
+main (int argc, char **argv)
+{
+  string editor = harness_editor (argc, argv);
+  int editors     = argc > 1 ? atoi (argv[1]) : 16;
+  double rate     = argc > 2 ? atof (argv[2]) : 50;
+  double seconds  = argc > 3 ? atof (argv[3]) : 3;
+  long debounce   = argc > 4 ? atol (argv[4]) : 5;
+  if (editors < 1 || editors > EDITOR_SLOTS || rate <= 0 || seconds <= 0
+      || debounce < 0) {
+    fprintf (stderr, "usage: %s [editors [saves/s [seconds [debounce ms]]]]\n",
+	     prog);
+    return 99;
+  }
+  harness_need_session_dir (prog);
+  get_signature ();
+  eval_XB (IntScalar (5, LOC), IntScalar (debounce, LOC));
+
+  files.resize (editors);
+  for (int f = 0; f < editors; f++) {
+    storm_file_s &sf = files[f];
+    sf.name = "s" + to_string (f);
+    sf.rate = rate;
+    sf.seconds = seconds;
+    sf.last_seq = sf.fixed_seq = 0;
+    harness_fix (save_text (sf.name, 0, 0));
+    eval_AXB (harness_str (editor), IntScalar (0, LOC),
+	      harness_str (sf.name));
+    reg_entry_s *re = reg_find (sf.name.c_str ());
+    if (!re || re->editor <= 0) {
+      fprintf (stderr, "%s: could not open %s\n", prog, sf.name.c_str ());
+      return 99;
+    }
+    sf.path = re->path;
+  }
+  standin_on_fix (on_fix);
+  edif2 (14, "");
+
+  for (storm_file_s &sf : files)
+    pthread_create (&sf.thread, NULL, editor_thread, &sf);
+  uint64_t stop = harness_ns () + (uint64_t)(seconds * 1e9);
+  while (harness_ns () < stop) {
+    edif2 (6, "");
+    harness_sleep_ms (1);
+  }
+  for (storm_file_s &sf : files) pthread_join (sf.thread, NULL);
+  uint64_t give_up = harness_ns () + 2000000000ULL;
+  while (!caught_up () && harness_ns () < give_up) {
+    edif2 (6, "");
+    harness_sleep_ms (1);
+  }
+
+  APL_Integer saves = 0, lost = 0;
+  for (storm_file_s &sf : files) {
+    saves += sf.last_seq;
+    if (sf.fixed_seq != sf.last_seq) lost += sf.last_seq - sf.fixed_seq;
+  }
+  printf ("%s: %d editors, %g saves/s each, %g s, debounce %ld ms\n",
+	  prog, editors, rate, seconds, debounce);
+  printf ("%s: save to fix  p50 %7.1f us  p99 %7.1f us  max %7.1f us\n",
+	  prog, harness_percentile (latencies, 50) / 1e3,
+	  harness_percentile (latencies, 99) / 1e3,
+	  harness_percentile (latencies, 100) / 1e3);
+  printf ("%s: saves %lld  fixed %zu  merged %lld  duplicates %lld  "
+	  "lost %lld\n", prog, (long long)saves, latencies.size (),
+	  (long long)storm_merged, (long long)storm_duplicates,
+	  (long long)lost);
+  printf ("%s: edif2 dropped %lld  rescans %lld  stat skips %lld  "
+	  "hash skips %lld  failed %lld\n", prog,
+	  (long long)counters[CNT_DROPPED], (long long)counters[CNT_RESCANS],
+	  (long long)counters[CNT_STAT_SKIPS],
+	  (long long)counters[CNT_HASH_SKIPS],
+	  (long long)counters[CNT_FAILED]);
+
+  standin_on_fix (NULL);
+  close_fun (CAUSE_SHUTDOWN, NULL);
+  CHECK (lost == 0);
+  CHECK (storm_duplicates == 0);
+  CHECK (counters[CNT_FAILED] == 0);
+  return harness_failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    edif's header scanner against the std::regex matchers it replaced:
+    the time to parse each form of header, and what building the three
+    matchers cost every time the library was loaded.  Then the time to
+    load libedif.so and libedif2.so themselves, when they have been
+    built, as ⎕fx does, with dlopen(); the program exports the stand-in
+    for them to bind to.
+***/
+
+#include <dlfcn.h>
+
+#include "edif.cc"
+#include "harness.hh"
+#include "regex_header.hh"
+
+static const char *prog = "edif_bench";
+static volatile size_t sink;
+
+static void
+bench_header (const regex_headers_s &rh, const char *header)
+{
+  const int rounds = 100000;
+  UTF8_string utf (header);
+  string locals;
+  uint64_t start = harness_ns ();
+  for (int i = 0; i < rounds; i++) sink += parse_header (utf, locals).size ();
+  uint64_t scan_ns = harness_ns () - start;
+
+  start = harness_ns ();
+  for (int i = 0; i < rounds / 10; i++)
+    sink += regex_parse_header (rh, header, locals).size ();
+  uint64_t regex_ns = (harness_ns () - start) * 10;
+
+  printf ("%s: header, scanner %7.1f ns  regex %8.1f ns  %s\n", prog,
+	  (double)scan_ns / rounds, (double)regex_ns / rounds, header);
+}
+
+static void
+bench_regex_build ()
+{
+  vector<uint64_t> ns;
+  for (int i = 0; i < 20; i++) {
+    uint64_t start = harness_ns ();
+    regex_headers_s *rh = regex_headers_build ();
+    ns.push_back (harness_ns () - start);
+    delete rh;
+  }
+  printf ("%s: %-34s %8.1f us  (median)\n", prog,
+	  "building the regex matchers", harness_percentile (ns, 50) / 1e3);
+}
+
+static void
+bench_load (const char *lib)
+{
+  string path = string ("./.libs/") + lib;
+  if (access (path.c_str (), R_OK) != 0) {
+    printf ("%s: loading %s: skipped, not built\n", prog, lib);
+    return;
+  }
+  vector<uint64_t> ns;
+  for (int i = 0; i < 20; i++) {
+    uint64_t start = harness_ns ();
+    void *h = dlopen (path.c_str (), RTLD_NOW | RTLD_LOCAL);
+    if (!h) {
+      printf ("%s: loading %s: %s\n", prog, lib, dlerror ());
+      return;
+    }
+    ns.push_back (harness_ns () - start);
+    dlclose (h);
+  }
+  string what = string ("loading ") + lib;
+  printf ("%s: %-34s %8.1f us  (median)\n", prog, what.c_str (),
+	  harness_percentile (ns, 50) / 1e3);
+}
+
+int
+main (int argc, char **argv)
+{
+  regex_headers_s *rh = regex_headers_build ();
+  bench_header (*rh, "f");
+  bench_header (*rh, "z←f x");
+  bench_header (*rh, "z←left fn right;t;u");
+  bench_header (*rh, "{z}←{a} (lo op ro) b;t");
+  bench_header (*rh, "not a header at all");
+  delete rh;
+  bench_regex_build ();
+  bench_load ("libedif.so");
+  bench_load ("libedif2.so");
+  return 0;
+}
@@ -0,0 +1,196 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    edif's header scanner: a table of headers, every form the scanner
+    knows and some it must refuse, each with the name and locals it
+    should find; then random headers and random junk, on which it must
+    agree with the std::regex matchers it replaced wherever they could
+    tell.  The scanner also skips leading blanks, which the matchers
+    didn't.  Last, a new lambda opened with a monadic or dyadic header
+    gets the header's locals in the text the editor is given.
+***/
+
+#include "edif.cc"
+#include "harness.hh"
+#include "regex_header.hh"
+
+static const char *prog = "edif_check";
+
+static void
+check_header (const char *header, const char *name, const char *locals)
+{
+  string got_locals;
+  string got = parse_header (UTF8_string (header), got_locals);
+  if (got != name || (*name && got_locals != locals)) {
+    harness_failures++;
+    fprintf (stderr, "%s: \"%s\" gave \"%s\" \"%s\", not \"%s\" \"%s\"\n",
+	     prog, header, got.c_str (), got_locals.c_str (), name,
+	     *name ? locals : "");
+  }
+}
+
+static void
+check_table ()
+{
+  check_header ("f",				"f", "");
+  check_header ("z←f",				"f", "");
+  check_header ("f x",				"f", "");
+  check_header ("z←f x",			"f", "");
+  check_header ("z←a f b",			"f", "");
+  check_header ("a f b",			"f", "");
+  check_header ("  z ← a  f\tb ",		"f", "");
+  check_header ("f;t",				"f", ";t");
+  check_header ("z←f x;t;u",			"f", ";t;u");
+  check_header ("z←a f b ; t ;u",		"f", "; t ;u");
+  check_header ("{z}←{a} f b;t",		"f", ";t");
+  check_header ("z←{a} f b",			"f", "");
+  check_header ("z←f[k] b",			"f", "");
+  check_header ("z←a f [ k ] b",		"f", "");
+  check_header ("z←(lo op ro) b",		"op", "");
+  check_header ("z←a (lo op) b;t",		"op", ";t");
+  check_header ("z←a ( lo op[k] ro ) b",	"op", "");
+  check_header ("∆f⍙2",				"∆f⍙2", "");
+  check_header ("z←a¯1 ⍙g_2 ∆b",		"⍙g_2", "");
+
+  check_header ("",				"", "");
+  check_header ("   ",				"", "");
+  check_header ("1f",				"", "");
+  check_header ("z←",				"", "");
+  check_header ("z←1 f",			"", "");
+  check_header ("a b c d",			"", "");
+  check_header ("z←{a} f",			"", "");
+  check_header ("z←a {f} b",			"", "");
+  check_header ("z←f[k",			"", "");
+  check_header ("z←f[k] a b",			"", "");
+  check_header ("z←(lo op b",			"", "");
+  check_header ("(lo op)←f",			"", "");
+  check_header ("z←f x y",			"x", "");
+  check_header ("f x+",				"", "");
+  check_header ("¯f",				"", "");
+}
+
+/***
+    A header in the old matchers' language: R←, one to three names,
+    locals, with blanks and tabs where they may go.
+***/
+
+static const char *name_parts[] = { "a", "Z", "fn", "∆", "⍙", "x1", "_", "¯" };
+static const char *blanks[] = { " ", "  ", "\t", " \t " };
+
+static string
+random_name (unsigned &seed)
+{
+  string nm = name_parts[rand_r (&seed) % 5];		// a letter first
+  int more = rand_r (&seed) % 4;
+  for (int i = 0; i < more; i++) nm += name_parts[rand_r (&seed) % 8];
+  return nm;
+}
+
+static string
+random_header (unsigned &seed)
+{
+  string h;
+  if (rand_r (&seed) % 2) {
+    h += random_name (seed);
+    if (rand_r (&seed) % 2) h += blanks[rand_r (&seed) % 4];
+    h += "←";
+    if (rand_r (&seed) % 2) h += blanks[rand_r (&seed) % 4];
+  }
+  int names = 1 + rand_r (&seed) % 3;
+  for (int i = 0; i < names; i++) {
+    if (i) h += blanks[rand_r (&seed) % 4];
+    h += random_name (seed);
+  }
+  if (rand_r (&seed) % 2) {
+    if (rand_r (&seed) % 2) h += blanks[rand_r (&seed) % 4];
+    int locals = 1 + rand_r (&seed) % 3;
+    for (int i = 0; i < locals; i++) h += ";" + random_name (seed);
+  }
+  return h;
+}
+
+static string
+random_junk (unsigned &seed)
+{
+  static const char *parts[] = { "a", "1", "_", "¯", "∆", " ", "←", ";",
+				 "x", "\t", "é", "+" };
+  string h;
+  int len = rand_r (&seed) % 10;
+  for (int i = 0; i < len; i++) h += parts[rand_r (&seed) % 12];
+  return h;
+}
+
+static void
+check_against_regex ()
+{
+  regex_headers_s *rh = regex_headers_build ();
+  unsigned seed = 20201017;
+  int disagreed = 0;
+  for (int i = 0; i < 20000; i++) {
+    string h = (i % 2) ? random_header (seed) : random_junk (seed);
+    string old_locals, new_locals;
+    string new_name = parse_header (UTF8_string (h.c_str ()), new_locals);
+    size_t text = h.find_first_not_of (" \t");	// the scanner allows these
+    if (text == string::npos) text = h.size ();
+    string old_name = regex_parse_header (*rh, h.c_str () + text, old_locals);
+    bool same = (old_name == new_name) &&
+      (old_locals.empty () || old_locals == new_locals);
+    if (!same && disagreed++ < 10)
+      fprintf (stderr, "%s: \"%s\": regex \"%s\" \"%s\", scanner \"%s\" "
+	       "\"%s\"\n", prog, h.c_str (), old_name.c_str (),
+	       old_locals.c_str (), new_name.c_str (), new_locals.c_str ());
+  }
+  CHECK (disagreed == 0);
+  delete rh;
+}
+
+/***
+    The editor is cp, which leaves a copy of the working file in scratch
+    for the test to read.
+***/
+
+static void
+check_new_lambda (const string &scratch, const char *header,
+		  const char *name, const char *text)
+{
+  string editor = "cp -t " + scratch;
+  Value_P X = IntScalar (1, LOC);
+  Token tok = eval_AXB (harness_str (editor), X, harness_str (header), NULL);
+  CHECK (harness_text (tok) == "");
+  CHECK (harness_read (scratch + "/" + name + ".apl") == text);
+}
+
+int
+main (int argc, char **argv)
+{
+  check_table ();
+  check_against_regex ();
+
+  harness_need_session_dir (prog);
+  string scratch = harness_scratch (prog);
+  get_signature ();
+  check_new_lambda (scratch, "z←f x;t",		"f", "f←{ ;t}");
+  check_new_lambda (scratch, "z←a g b ; t ;u",	"g", "g←{ ; t ;u}");
+  close_fun (CAUSE_SHUTDOWN, NULL);
+  harness_remove (scratch);
+  return harness_done (prog);
+}
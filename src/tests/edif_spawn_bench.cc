@@ -0,0 +1,140 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    Starting an editor against the size of the workspace: for a process
+    with nothing, 256 MB and 1 GB of heap touched, the time from asking
+    for /bin/true to be run on a file until it has exited, started
+
+      spawn		by spawn_editor(), posix_spawnp() with no shell
+      spawn, shell	by spawn_editor() for a command that needs one
+      fork+sh		as edif2 did, fork() then /bin/sh -c
+      system()		as edif did
+
+    and, for the first and third, how long the caller was held up
+    before it could get on with something else.
+***/
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "edif_spawn.hh"
+#include "harness.hh"
+
+static const char *prog = "edif_spawn_bench";
+static const int rounds = 20;
+
+static void
+wait_for (pid_t pid)
+{
+  int wstatus;
+  while (waitpid (pid, &wstatus, 0) == -1 && errno == EINTR) ;
+}
+
+static void
+report (const char *how, size_t heap_mb, std::vector<uint64_t> &done,
+	std::vector<uint64_t> *held)
+{
+  char what[64];
+  snprintf (what, sizeof(what), "%s, %zu MB heap", how, heap_mb);
+  printf ("%s: %-28s done %8.1f us", prog, what,
+	  harness_percentile (done, 50) / 1e3);
+  if (held) printf ("  held %8.1f us", harness_percentile (*held, 50) / 1e3);
+  printf ("  (median)\n");
+}
+
+static void
+bench_spawn (const char *how, const char *cmd, size_t heap_mb)
+{
+  std::vector<std::string> files (1, "/dev/null");
+  std::vector<uint64_t> done, held;
+  for (int r = 0; r < rounds; r++) {
+    pid_t pid;
+    uint64_t start = harness_ns ();
+    if (spawn_editor (cmd, files, &pid, -1) != 0) {
+      printf ("%s: %s: cannot start %s\n", prog, how, cmd);
+      return;
+    }
+    held.push_back (harness_ns () - start);
+    wait_for (pid);
+    done.push_back (harness_ns () - start);
+  }
+  report (how, heap_mb, done, &held);
+}
+
+static void
+bench_fork_sh (size_t heap_mb)
+{
+  std::vector<uint64_t> done, held;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = harness_ns ();
+    pid_t pid = fork ();
+    if (pid == 0) {
+      execl ("/bin/sh", "sh", "-c", "/bin/true /dev/null", (char *)NULL);
+      _exit (127);
+    }
+    held.push_back (harness_ns () - start);
+    wait_for (pid);
+    done.push_back (harness_ns () - start);
+  }
+  report ("fork+sh", heap_mb, done, &held);
+}
+
+static void
+bench_system (size_t heap_mb)
+{
+  std::vector<uint64_t> done;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = harness_ns ();
+    if (system ("/bin/true /dev/null") != 0) {
+      printf ("%s: system() failed\n", prog);
+      return;
+    }
+    done.push_back (harness_ns () - start);
+  }
+  report ("system()", heap_mb, done, NULL);
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t sizes[] = { 0, 256, 1024 };
+  for (size_t heap_mb : sizes) {
+    size_t len = heap_mb << 20;
+    char *heap = NULL;
+    if (len) {
+      heap = (char *)mmap (NULL, len, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (heap == MAP_FAILED) {
+	printf ("%s: %zu MB heap: skipped\n", prog, heap_mb);
+	continue;
+      }
+      memset (heap, 1, len);
+    }
+    bench_spawn ("spawn", "/bin/true", heap_mb);
+    bench_spawn ("spawn, shell", "/bin/true 2>/dev/null", heap_mb);
+    bench_fork_sh (heap_mb);
+    bench_system (heap_mb);
+    if (heap) munmap (heap, len);
+  }
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    Reading an edited function back, for a function of 10000 lines as
+    edif writes one: mostly ASCII with some APL, all APL, and the first
+    with a corrupted byte in every line.  For each, the throughput of
+    the code point count and of decode_utf8() alone, of text_to_ucs()
+    as edif and edif2 call it, and of the reference decoder; then the
+    whole read from the file, map_file() and text_to_ucs() against the
+    getline() and append_UTF8() loop that did it before.  The old loop
+    decodes with the stand-in's append_UTF8(), not GNU APL's, so that
+    last comparison is of the two ways of going about it rather than of
+    the decoders.
+***/
+
+#include <fstream>
+
+#include "edif_read.hh"
+#include "harness.hh"
+#include "utf8_reference.hh"
+
+static const char *prog = "edif_text_bench";
+static const int lines = 10000;
+static volatile size_t sink;
+
+static std::string
+function_text (bool apl_only, bool corrupt)
+{
+  static const char *ascii[] = { "z", "x", "i", "+", "1", " ", "(", ")",
+				 "count", "0", ";", "]" };
+  static const char *apl[] = { "←", "⍴", "⍳", "⍵", "⍺", "∇", "⍝", "⌽", "∊",
+			       "⊃", "¯", "×" };
+  unsigned seed = 17;
+  std::string text = "z←f x;i;count\n";
+  for (int l = 1; l < lines; l++) {
+    text += "  ";
+    int len = 20 + rand_r (&seed) % 40;
+    for (int k = 0; k < len; k++) {
+      bool glyph = apl_only || rand_r (&seed) % 8 == 0;
+      text += glyph ? apl[rand_r (&seed) % 12] : ascii[rand_r (&seed) % 12];
+    }
+    if (corrupt) text += "\xe2\x8d";
+    text += "\n";
+  }
+  return text;
+}
+
+static void
+report (const char *what, const char *how, size_t bytes, std::vector<uint64_t> &ns)
+{
+  double med = harness_percentile (ns, 50);
+  char label[80];
+  snprintf (label, sizeof(label), "%s, %s", what, how);
+  printf ("%s: %-44s %8.1f us  %7.1f MB/s  (median)\n", prog, label,
+	  med / 1e3, bytes * 1e3 / (med ? med : 1));
+}
+
+struct u32_sink {
+  std::u32string s;
+  void append (char32_t c) { s.push_back (c); }
+};
+
+static void
+bench_decode (const char *what, const std::string &text)
+{
+  const int rounds = 20;
+  std::vector<uint64_t> count_ns, decode_ns, to_ucs_ns, ref_ns;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = harness_ns ();
+    sink += utf8_count (text.data (), text.size ());
+    count_ns.push_back (harness_ns () - start);
+
+    u32_sink out;
+    out.s.reserve (text.size ());
+    start = harness_ns ();
+    decode_utf8<u32_sink, char32_t> (text.data (), text.size (), out);
+    decode_ns.push_back (harness_ns () - start);
+    sink += out.s.size ();
+
+    UCS_string ucs;
+    start = harness_ns ();
+    text_to_ucs (text.data (), text.size (), ucs, NULL);
+    to_ucs_ns.push_back (harness_ns () - start);
+    sink += ucs.size ();
+
+    std::u32string ref;
+    start = harness_ns ();
+    utf8_reference_decode (text, ref);
+    ref_ns.push_back (harness_ns () - start);
+    sink += ref.size ();
+  }
+  report (what, "utf8_count", text.size (), count_ns);
+  report (what, "decode_utf8", text.size (), decode_ns);
+  report (what, "text_to_ucs", text.size (), to_ucs_ns);
+  report (what, "reference decoder", text.size (), ref_ns);
+}
+
+static void
+bench_read (const char *what, const std::string &fn, size_t bytes)
+{
+  const int rounds = 20;
+  std::vector<uint64_t> map_ns, line_ns;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = harness_ns ();
+    mapped_file_s mf;
+    UCS_string ucs;
+    if (map_file (fn.c_str (), mf)) {
+      text_to_ucs (mf.data, mf.size, ucs, NULL);
+      unmap_file (mf);
+    }
+    map_ns.push_back (harness_ns () - start);
+    sink += ucs.size ();
+
+    start = harness_ns ();
+    std::ifstream tfile;
+    tfile.open (fn, std::ios::in);
+    UCS_string old;
+    if (tfile.is_open ()) {
+      std::string line;
+      while (getline (tfile, line)) {
+	old.append_UTF8 (line.c_str ());
+	old.append (UNI_LF);
+      }
+      tfile.close ();
+    }
+    line_ns.push_back (harness_ns () - start);
+    sink += old.size ();
+  }
+  report (what, "read, map_file + text_to_ucs", bytes, map_ns);
+  report (what, "read, getline + append_UTF8", bytes, line_ns);
+}
+
+int
+main (int argc, char **argv)
+{
+  std::string scratch = harness_scratch (prog);
+  std::string fn = scratch + "/f.apl";
+
+  struct {
+    const char *what;
+    bool        apl_only;
+    bool        corrupt;
+  } texts[] = {
+    { "mostly ASCII", false, false },
+    { "all APL",      true,  false },
+    { "corrupted",    false, true  },
+  };
+  for (auto &t : texts) {
+    std::string text = function_text (t.apl_only, t.corrupt);
+    bench_decode (t.what, text);
+    if (!harness_write (fn, text)) {
+      perror (fn.c_str ());
+      return 99;
+    }
+    bench_read (t.what, fn, text.size ());
+  }
+
+  harness_remove (scratch);
+  return 0;
+}
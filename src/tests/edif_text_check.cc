@@ -0,0 +1,252 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    The UTF-8 decoding behind reading an edited function back, against
+    the byte-at-a-time reference decoder in utf8_reference.hh: the
+    examples in the Unicode standard and the usual ill-formed cases,
+    then random text, valid and then corrupted, in lengths that put the
+    eight-byte ASCII runs on and off every boundary.  The code point
+    count must agree with the decoder's, encode_utf8() must undo
+    decode_utf8() on valid text, and text_to_ucs() must end the last
+    line and find the first.
+***/
+
+#include "edif_read.hh"
+#include "harness.hh"
+#include "utf8_reference.hh"
+
+static const char *prog = "edif_text_check";
+
+struct u32_sink {
+  std::u32string s;
+  void append (char32_t c) { s.push_back (c); }
+};
+
+static std::u32string
+decoded (const std::string &utf)
+{
+  u32_sink sink;
+  decode_utf8<u32_sink, char32_t> (utf.data (), utf.size (), sink);
+  return sink.s;
+}
+
+static std::string
+shown (const std::string &utf)
+{
+  std::string s;
+  char hex[4];
+  for (unsigned char c : utf) {
+    snprintf (hex, sizeof(hex), "%02X ", c);
+    s += hex;
+  }
+  return s;
+}
+
+static std::string
+shown (const std::u32string &ucs)
+{
+  std::string s;
+  char hex[12];
+  for (char32_t c : ucs) {
+    snprintf (hex, sizeof(hex), "%04X ", (unsigned)c);
+    s += hex;
+  }
+  return s;
+}
+
+static int disagreed = 0;
+
+static void
+check_text (const std::string &utf)
+{
+  std::u32string got = decoded (utf);
+  std::u32string want;
+  utf8_reference_decode (utf, want);
+  bool same = (got == want);
+  size_t starts = 0;			// bytes that aren't 10xxxxxx
+  for (unsigned char c : utf) starts += ((c & 0xc0) != 0x80);
+  if (utf8_count (utf.data (), utf.size ()) != starts) same = false;
+  if (!same && disagreed++ < 10)
+    fprintf (stderr, "%s: %s\n  gave %s\n  not  %s\n", prog,
+	     shown (utf).c_str (), shown (got).c_str (), shown (want).c_str ());
+}
+
+static void
+check_decodes_to (const char *utf, std::u32string want)
+{
+  std::u32string got = decoded (utf);
+  if (got != want) {
+    harness_failures++;
+    fprintf (stderr, "%s: %s gave %s, not %s\n", prog, shown (utf).c_str (),
+	     shown (got).c_str (), shown (want).c_str ());
+  }
+  check_text (utf);
+}
+
+static void
+check_table ()
+{
+  check_decodes_to ("", U"");
+  check_decodes_to ("z←⍴⍵ ⍝ 𝔸", U"z←⍴⍵ ⍝ 𝔸");
+  check_decodes_to ("\x7f\xc2\x80\xdf\xbf\xe0\xa0\x80\xef\xbf\xbf"
+		    "\xf0\x90\x80\x80\xf4\x8f\xbf\xbf",
+		    U"\x7f\x80\x7ff\x800\xffff\x10000\x10ffff");
+
+  // The example in chapter 3 of the standard
+  check_decodes_to ("\x61\xf1\x80\x80\xe1\x80\xc2\x62\x80\x63\x80\xbf\x64",
+		    U"a\xfffd\xfffd\xfffd" "b\xfffd" "c\xfffd\xfffd" "d");
+
+  check_decodes_to ("\xc0\xaf", U"\xfffd\xfffd");		// overlong
+  check_decodes_to ("\xc1\xbf", U"\xfffd\xfffd");
+  check_decodes_to ("\xe0\x80\xaf", U"\xfffd\xfffd\xfffd");
+  check_decodes_to ("\xf0\x80\x80\xaf", U"\xfffd\xfffd\xfffd\xfffd");
+  check_decodes_to ("\xed\xa0\x80", U"\xfffd\xfffd\xfffd");	// surrogate
+  check_decodes_to ("\xed\x9f\xbf", U"\xd7ff");
+  check_decodes_to ("\xf4\x90\x80\x80", U"\xfffd\xfffd\xfffd\xfffd");
+  check_decodes_to ("\xf5\x80", U"\xfffd\xfffd");
+  check_decodes_to ("\xfe\xff", U"\xfffd\xfffd");
+  check_decodes_to ("\x80\xbf", U"\xfffd\xfffd");		// lone trail
+  check_decodes_to ("\xe2\x8d", U"\xfffd");			// cut short
+  check_decodes_to ("ab\xf0\x9d\x94", U"ab\xfffd");
+  check_decodes_to ("\xe2\x8dx", U"\xfffdx");
+  check_decodes_to ("abcdefg\xe2\x8d\xb4", U"abcdefg⍴");	// across 8
+  check_decodes_to ("abcdefgh\xe2", U"abcdefgh\xfffd");
+}
+
+/***
+    Random code points, mostly ASCII in runs of up to twenty, then
+    APL and other BMP characters, with now and then one from past the
+    BMP; never a surrogate.
+***/
+
+static std::u32string
+random_ucs (unsigned &seed)
+{
+  std::u32string ucs;
+  int len = rand_r (&seed) % 64;
+  while ((int)ucs.size () < len) {
+    switch (rand_r (&seed) % 4) {
+    case 0:
+    case 1:
+      for (int run = rand_r (&seed) % 21; run > 0; run--)
+	ucs.push_back (0x20 + rand_r (&seed) % 0x5f);
+      break;
+    case 2:
+      ucs.push_back (0x2190 + rand_r (&seed) % 0x100);		// arrows, APL
+      break;
+    default:
+      switch (rand_r (&seed) % 3) {
+      case 0:  ucs.push_back (0x80 + rand_r (&seed) % 0x780);      break;
+      case 1:  ucs.push_back (0xe000 + rand_r (&seed) % 0x2000);   break;
+      default: ucs.push_back (0x10000 + rand_r (&seed) % 0x100000); break;
+      }
+    }
+  }
+  return ucs;
+}
+
+/***
+    Some bytes of utf changed, dropped or added, or the end cut off.
+***/
+
+static std::string
+corrupted (std::string utf, unsigned &seed)
+{
+  static const unsigned char odd[] = { 0x80, 0xbf, 0xc0, 0xc2, 0xe0, 0xed,
+				       0xef, 0xf0, 0xf4, 0xf5, 0xff, 0x9f };
+  int changes = 1 + rand_r (&seed) % 3;
+  for (int c = 0; c < changes; c++) {
+    size_t at = utf.empty () ? 0 : rand_r (&seed) % utf.size ();
+    unsigned char b = (rand_r (&seed) % 2) ? odd[rand_r (&seed) % 12]
+      : rand_r (&seed) % 256;
+    switch (rand_r (&seed) % 4) {
+    case 0:  if (!utf.empty ()) utf[at] = b;            break;
+    case 1:  if (!utf.empty ()) utf.erase (at, 1);      break;
+    case 2:  utf.insert (at, 1, (char)b);               break;
+    default: utf.resize (at);                            break;
+    }
+  }
+  return utf;
+}
+
+static void
+check_random ()
+{
+  unsigned seed = 20201017;
+  int wrong_way_back = 0;
+  for (int i = 0; i < 100000; i++) {
+    std::u32string ucs = random_ucs (seed);
+    std::string utf;
+    encode_utf8 (ucs.data (), ucs.size (), utf);
+    check_text (utf);
+    if (decoded (utf) != ucs && wrong_way_back++ < 10)
+      fprintf (stderr, "%s: %s did not come back\n", prog,
+	       shown (ucs).c_str ());
+    check_text (corrupted (utf, seed));
+  }
+  CHECK (wrong_way_back == 0);
+
+  for (int i = 0; i < 100000; i++) {		// nothing but bytes
+    std::string junk;
+    for (int len = rand_r (&seed) % 24; len > 0; len--)
+      junk += (char)(rand_r (&seed) % 256);
+    check_text (junk);
+  }
+  CHECK (disagreed == 0);
+}
+
+static void
+check_encode ()
+{
+  const char32_t bad[] = { 0xd800, 0xdfff, 0x110000, 0xffffffff };
+  for (char32_t c : bad) {
+    std::string utf;
+    encode_utf8 (&c, 1, utf);
+    CHECK (utf == "\xef\xbf\xbd");
+  }
+}
+
+static void
+check_text_to_ucs ()
+{
+  const char *texts[] = { "", "z←f x\n  z←⍴x\n", "z←f x\n  z←⍴x",
+			  "{⍵+1}", "a\xff\nb" };
+  const char *want_first[] = { "", "z←f x", "z←f x", "{⍵+1}", "a\xef\xbf\xbd" };
+  const char *want_all[] = { "", "z←f x\n  z←⍴x\n", "z←f x\n  z←⍴x\n",
+			     "{⍵+1}\n", "a\xef\xbf\xbd\nb\n" };
+  for (int i = 0; i < 5; i++) {
+    UCS_string ucs, first;
+    text_to_ucs (texts[i], strlen (texts[i]), ucs, &first);
+    CHECK (ucs == harness_ucs (want_all[i]));
+    CHECK (first == harness_ucs (want_first[i]));
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  check_table ();
+  check_random ();
+  check_encode ();
+  check_text_to_ucs ();
+  return harness_done (prog);
+}
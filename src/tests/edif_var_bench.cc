@@ -0,0 +1,181 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    Exporting variables of different shapes, as edif and edif2 write
+    them to their working files: the time, the rate in cells and bytes,
+    and how far the resident set rose above what the array itself takes
+    while it was written.  The integer matrix comes in two sizes, to
+    show that rise doesn't grow with the array.  Nested arrays, wide
+    and deep, are also read back, and that is timed too.
+***/
+
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "edif_var.hh"
+#include "harness.hh"
+
+static const char *prog = "edif_var_bench";
+static std::string out_path;
+
+typedef enum { FILL_INT, FILL_FLOAT, FILL_CHAR } fill_e;
+
+static Value_P
+simple_value (const Shape &sh, fill_e fill)
+{
+  Value_P Z (sh, LOC);
+  loop (i, sh.get_volume ()) {
+    switch (fill) {
+    case FILL_INT:   Z->next_ravel_Int (i % 100000 - 500); break;
+    case FILL_FLOAT: Z->next_ravel_Float (i * 0.5 + 0.25); break;
+    case FILL_CHAR:  Z->next_ravel_Char ('a' + i % 26); break;
+    }
+  }
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    items vectors of five integers each.
+***/
+
+static Value_P
+nested_value (ShapeItem items)
+{
+  Value_P Z (Shape (items), LOC);
+  loop (i, items) {
+    Value_P V (Shape (5), LOC);
+    loop (k, 5) V->next_ravel_Int (i + k);
+    V->check_value (LOC);
+    Z->next_ravel_Pointer (V.get ());
+  }
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    depth enclosures of a vector of five integers.
+***/
+
+static Value_P
+deep_value (int depth)
+{
+  Value_P Z (Shape (5), LOC);
+  loop (k, 5) Z->next_ravel_Int (k);
+  Z->check_value (LOC);
+  for (int d = 0; d < depth; d++) {
+    Value_P E (Shape (), LOC);
+    E->next_ravel_Pointer (Z.get ());
+    E->check_value (LOC);
+    Z = E;
+  }
+  return Z;
+}
+
+/***
+    nested is the number of cells in a nested array, enclosures of
+    single items included, for the rate, and 0 for a simple one.
+***/
+
+static void
+bench_export (const char *what, const Value &val, ShapeItem nested = 0)
+{
+  long rss = harness_rss_kb ();
+  bool reset = harness_reset_peak ();
+  int fd = open (out_path.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		 0600);
+  if (fd == -1) {
+    perror (out_path.c_str ());
+    exit (99);
+  }
+  uint64_t start = harness_ns ();
+  const char *err = nested ? write_nested (fd, val) : write_value (fd, val);
+  uint64_t ns = harness_ns () - start;
+  close (fd);
+  long peak = harness_peak_rss_kb ();
+  if (err) {
+    printf ("%s: %s: %s\n", prog, what, err);
+    exit (1);
+  }
+  struct stat sb;
+  stat (out_path.c_str (), &sb);
+  ShapeItem cells = nested ? nested : val.element_count ();
+  char rise[32];
+  if (reset) snprintf (rise, sizeof(rise), "%6ld kB", peak - rss);
+  else snprintf (rise, sizeof(rise), "%9s", "n/a");
+  printf ("%s: %-34s %8.1f ms  %6.1f Mcells/s  %6.1f MB/s  rss +%s\n",
+	  prog, what, ns / 1e6, cells * 1e3 / (ns ? ns : 1),
+	  sb.st_size * 1e3 / (ns ? ns : 1), rise);
+  if (!nested) return;
+
+  std::string text = harness_read (out_path);
+  start = harness_ns ();
+  Value_P back = nested_to_value (text, err);
+  ns = harness_ns () - start;
+  if (err || !back) {
+    printf ("%s: %s, read back: %s\n", prog, what, err ? err : "nothing");
+    exit (1);
+  }
+  std::string again = std::string (what) + ", read back";
+  printf ("%s: %-34s %8.1f ms  %6.1f Mcells/s  %6.1f MB/s\n",
+	  prog, again.c_str (), ns / 1e6, cells * 1e3 / (ns ? ns : 1),
+	  text.size () * 1e3 / (ns ? ns : 1));
+}
+
+int
+main (int argc, char **argv)
+{
+  std::string scratch = harness_scratch (prog);
+  out_path = scratch + "/var.txt";
+
+  struct {
+    const char *what;
+    Shape       shape;
+    fill_e      fill;
+  } shapes[] = {
+    { "int vector 2000000",      Shape (2000000),     FILL_INT   },
+    { "int matrix 500x1000",     Shape (500, 1000),   FILL_INT   },
+    { "int matrix 2000x1000",    Shape (2000, 1000),  FILL_INT   },
+    { "float matrix 1000x2000",  Shape (1000, 2000),  FILL_FLOAT },
+    { "int array 100x100x200",   Shape (),            FILL_INT   },
+    { "char matrix 20000x100",   Shape (20000, 100),  FILL_CHAR  },
+  };
+  shapes[4].shape.add_shape_item (100);
+  shapes[4].shape.add_shape_item (100);
+  shapes[4].shape.add_shape_item (200);
+
+  for (auto &s : shapes) {
+    Value_P V = simple_value (s.shape, s.fill);
+    bench_export (s.what, *V);
+  }
+  {
+    Value_P V = nested_value (200000);
+    bench_export ("nested 200000 x 5 ints", *V, 200000 * 5);
+  }
+  {
+    Value_P V = deep_value (5000);
+    bench_export ("nested 5000 deep", *V, 5000 + 5);
+  }
+
+  harness_remove (scratch);
+  return 0;
+}
@@ -0,0 +1,289 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/***
+    Nested and mixed variables through the line-per-item format and
+    back: a thousand levels deep, a hundred thousand items wide, every
+    kind of scalar, escaped and non-ASCII characters, matrices of
+    items, empty arrays and floats no short decimal holds.  What comes back must be the same array,
+    and text that doesn't describe one must be refused.
+***/
+
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "edif_var.hh"
+#include "harness.hh"
+
+static const char *prog = "edif_var_check";
+static std::string out_path;
+
+/***
+    A numeric cell's value.  Numbers are compared by value, as APL
+    compares them: 5.0 is written as 5 and comes back an integer.
+***/
+
+static bool
+number (const Cell &cell, APL_Float &re, APL_Float &im)
+{
+  re = im = 0;
+  if (cell.is_integer_cell ()) re = cell.get_int_value ();
+  else if (cell.is_complex_cell ()) {
+    re = cell.get_real_value ();
+    im = cell.get_imag_value ();
+  }
+  else if (cell.is_float_cell ()) re = cell.get_real_value ();
+  else return false;
+  return true;
+}
+
+/***
+    The same array: shape, and cell by cell the same characters, the
+    same numbers and the same items.  An empty array's prototype is only
+    checked for being characters or not, which is all the format keeps
+    of it.
+***/
+
+static bool
+same_value (const Value &a, const Value &b)
+{
+  if (!(a.get_shape () == b.get_shape ())) return false;
+  ShapeItem count = a.element_count ();
+  if (count == 0)
+    return a.get_ravel (0).is_character_cell ()
+      == b.get_ravel (0).is_character_cell ();
+  loop (i, count) {
+    const Cell &x = a.get_ravel (i);
+    const Cell &y = b.get_ravel (i);
+    if (x.is_pointer_cell ()) {
+      if (!y.is_pointer_cell ()) return false;
+      if (!same_value (*x.get_pointer_value ().get (),
+		       *y.get_pointer_value ().get ()))
+	return false;
+    }
+    else if (x.is_character_cell ()) {
+      if (!y.is_character_cell ()
+	  || x.get_char_value () != y.get_char_value ())
+	return false;
+    }
+    else {
+      APL_Float xre, xim, yre, yim;
+      if (!number (x, xre, xim) || !number (y, yre, yim)
+	  || xre != yre || xim != yim)
+	return false;
+    }
+  }
+  return true;
+}
+
+static std::string
+nested_text (const Value &val)
+{
+  int fd = open (out_path.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		 0600);
+  CHECK (fd != -1);
+  CHECK (write_nested (fd, val) == NULL);
+  close (fd);
+  return harness_read (out_path);
+}
+
+static void
+check_round_trip (const char *what, const Value &val)
+{
+  std::string text = nested_text (val);
+  const char *err = NULL;
+  Value_P back = nested_to_value (text, err);
+  if (err || !back || !same_value (val, *back)) {
+    harness_failures++;
+    fprintf (stderr, "%s: %s did not come back: %s\n", prog, what,
+	     err ? err : "a different array");
+  }
+}
+
+static Value_P
+string_value (const char *utf)
+{
+  UCS_string ucs = harness_ucs (utf);
+  Value_P Z (Shape ((ShapeItem)ucs.size ()), LOC);
+  for (Unicode uni : ucs) Z->next_ravel_Char (uni);
+  if (ucs.empty ()) Z->set_default_Spc ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+static Value_P
+int_vector (ShapeItem len, APL_Integer first)
+{
+  Value_P Z (Shape (len), LOC);
+  loop (i, len) Z->next_ravel_Int (first + i);
+  if (len == 0) Z->set_default_Zero ();
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    depth levels of enclosure around 1 2 3, alternately scalars and
+    one-item vectors.
+***/
+
+static Value_P
+deep_value (int depth)
+{
+  Value_P Z = int_vector (3, 1);
+  for (int d = 0; d < depth; d++) {
+    Value_P E (d % 2 ? Shape (1) : Shape (), LOC);
+    E->next_ravel_Pointer (Z.get ());
+    E->check_value (LOC);
+    Z = E;
+  }
+  return Z;
+}
+
+static Value_P
+wide_value (ShapeItem items)
+{
+  static const Unicode chars[] = { 'a', 0x2374, ' ', '\\', '\n' };
+  Value_P Z (Shape (items), LOC);
+  loop (i, items) {
+    switch (i % 10) {
+    case 0: Z->next_ravel_Int (i - 50000);                           break;
+    case 1: Z->next_ravel_Char (chars[i % 5]);                       break;
+    case 2: Z->next_ravel_Float (i * 0.25 - 0.5);                    break;
+    case 3: Z->next_ravel_Complex (i, -1.5);                         break;
+    case 4: Z->next_ravel_Pointer (int_vector (3, i).get ());        break;
+    case 5: Z->next_ravel_Pointer (string_value ("a\nb\\c\r ").get ()); break;
+    case 6: Z->next_ravel_Pointer (string_value ("⍴⍳∆ ⍝").get ());     break;
+    case 7: Z->next_ravel_Pointer (int_vector (0, 0).get ());        break;
+    case 8: Z->next_ravel_Pointer (string_value ("").get ());         break;
+    case 9: Z->next_ravel_Pointer (deep_value (3).get ());           break;
+    }
+  }
+  Z->check_value (LOC);
+  return Z;
+}
+
+static void
+check_shapes ()
+{
+  check_round_trip ("deep", *deep_value (1000));
+  check_round_trip ("wide", *wide_value (100000));
+
+  Value_P mixed (Shape (3), LOC);		// simple, but not plain
+  mixed->next_ravel_Int (1);
+  mixed->next_ravel_Char ('a');
+  mixed->next_ravel_Float (2.5);
+  mixed->check_value (LOC);
+  check_round_trip ("mixed", *mixed);
+
+  Value_P matrix (Shape (2, 3), LOC);
+  loop (i, 6) matrix->next_ravel_Pointer (string_value ("ab c").get ());
+  matrix->check_value (LOC);
+  check_round_trip ("matrix of strings", *matrix);
+
+  Value_P empty (Shape (0), LOC);		// 0⍴⊂1 2
+  empty->set_default_Zero ();
+  empty->check_value (LOC);
+  check_round_trip ("empty", *empty);
+
+  Value_P scalar (Shape (), LOC);
+  scalar->next_ravel_Int (42);
+  scalar->check_value (LOC);
+  check_round_trip ("scalar", *scalar);
+  CHECK (nested_text (*scalar) == "# : 42\n");
+}
+
+/***
+    Floats that no short decimal holds must come back bit for bit,
+    through the flat format as well as the nested one: they are written
+    with as many digits as that takes, not to ⎕PP.
+***/
+
+static void
+check_inexact ()
+{
+  static const APL_Float reals[] = {
+    1.0 / 3, -2.0 / 3, 0.1, 0.1 + 0.2, 1e300 / 7, 1e-300 / 3, 2.0 / 7e-5
+  };
+  const int count = sizeof(reals) / sizeof(reals[0]);
+  Value_P Z (Shape ((ShapeItem)count + 1), LOC);
+  for (APL_Float re : reals) Z->next_ravel_Float (re);
+  Z->next_ravel_Complex (1.0 / 3, -1.0 / 7);
+  Z->check_value (LOC);
+  check_round_trip ("inexact", *Z);
+
+  int fd = open (out_path.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		 0600);
+  CHECK (fd != -1);
+  CHECK (write_value (fd, *Z) == NULL);
+  close (fd);
+  const char *err = NULL;
+  Value_P back = text_to_value (harness_read (out_path), false,
+				Z->get_shape (), err);
+  CHECK (err == NULL && !!back && same_value (*Z, *back));
+
+  Value_P third (Shape (), LOC);
+  third->next_ravel_Float (1.0 / 3);
+  third->check_value (LOC);
+  CHECK (nested_text (*third) == "# : 0.3333333333333333\n");
+}
+
+static void
+check_refused (const char *text, const char *want)
+{
+  const char *err = NULL;
+  Value_P Z = nested_to_value (text, err);
+  CHECK (!Z);
+  if (!err || strcmp (err, want)) {
+    harness_failures++;
+    fprintf (stderr, "%s: \"%s\" gave %s, not %s\n", prog, text,
+	     err ? err : "no error", want);
+  }
+}
+
+static void
+check_bad_text ()
+{
+  check_refused ("# 3 : 1 2\n", "Item count doesn't match the shape.");
+  check_refused ("' 2 : abc\n", "Item count doesn't match the shape.");
+  check_refused ("⊂ 2\n  # : 1\n", "Missing items.");
+  check_refused ("# : 1\n# : 2\n", "Extra lines after the value.");
+  check_refused ("# 2 : 1 x\n", "Invalid number.");
+  check_refused ("# 2 : 1 inf\n", "Invalid number.");
+  check_refused ("# 2 : nan 1\n", "Invalid number.");
+  check_refused ("# 2 : 1 ¯infinity\n", "Invalid number.");
+  check_refused ("# : 1Jnan\n", "Invalid number.");
+  check_refused ("1 2 3\n", "Unrecognised line.");
+  check_refused ("⊂ 1 : 2\n", "Unrecognised line.");
+}
+
+int
+main (int argc, char **argv)
+{
+  std::string scratch = harness_scratch (prog);
+  out_path = scratch + "/var.txt";
+
+  check_shapes ();
+  check_inexact ();
+  check_bad_text ();
+
+  harness_remove (scratch);
+  return harness_done (prog);
+}
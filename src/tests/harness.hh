@@ -0,0 +1,311 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HARNESS_HH
+#define HARNESS_HH
+
+/***
+    Shared by the checks and benchmarks in this directory, which run
+    edif and edif2 against the stand-in GNU APL in ../standin.  Each
+    program includes the library source it exercises, so it can call
+    the eval functions the way the interpreter does and still look at
+    the counters and tables behind them.
+
+    A program that needs an editor that stays up runs itself with
+    --editor, which just waits to be killed, or for whatever started
+    it to exit.  One that needs a session directory and cannot make
+    /var/run/user/<uid> is skipped, with the exit status 77 automake
+    expects.
+***/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "standin.hh"
+
+static int harness_failures = 0;
+
+#define CHECK(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      harness_failures++;						\
+      fprintf (stderr, "%s:%d: check failed: %s\n",			\
+	       __FILE__, __LINE__, #cond);				\
+    }									\
+  } while (0)
+
+static inline uint64_t
+harness_ns ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+harness_sleep_ms (long ms)
+{
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+  while (nanosleep (&ts, &ts) == -1 && errno == EINTR) ;
+}
+
+static inline UCS_string
+harness_ucs (const std::string &utf)
+{
+  return UCS_string (UTF8_string (utf.c_str ()));
+}
+
+static inline Value_P
+harness_str (const std::string &utf)
+{
+  Value_P Z (harness_ucs (utf), LOC);
+  Z->check_value (LOC);
+  return Z;
+}
+
+/***
+    A result that should be a character vector, as UTF-8; anything
+    else comes back as "?".
+***/
+
+static inline std::string
+harness_text (const Token &tok)
+{
+  Value_P Z = tok.get_apl_val ();
+  if (!Z || !Z->is_char_string ()) return "?";
+  UTF8_string utf (Z->get_UCS_ravel ());
+  return std::string (utf.c_str (), utf.size ());
+}
+
+static inline APL_Integer
+harness_int (const Token &tok, ShapeItem i = 0)
+{
+  Value_P Z = tok.get_apl_val ();
+  if (!Z || i >= Z->nz_element_count ()) return -1;
+  const Cell &cell = Z->get_ravel (i);
+  return cell.is_integer_cell () ? cell.get_int_value () : -1;
+}
+
+static inline bool
+harness_fix (const std::string &text)
+{
+  int err_line = 0;
+  return NULL != UserFunction::fix (harness_ucs (text), err_line, false,
+				    LOC, UTF8_string ("harness"), true);
+}
+
+/***
+    The function's canonical text as UTF-8, or "" if there is none.
+***/
+
+static inline std::string
+harness_canonical (const std::string &name)
+{
+  NamedObject *obj = Workspace::lookup_existing_name (harness_ucs (name));
+  const Function *fun = obj ? obj->get_function () : NULL;
+  if (!fun) return "";
+  UTF8_string utf (fun->canonical (false));
+  return std::string (utf.c_str (), utf.size ());
+}
+
+/***
+    Write text to path in place, the way most editors save.
+***/
+
+static inline bool
+harness_write (const std::string &path, const std::string &text)
+{
+  int fd = open (path.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		 0600);
+  if (fd == -1) return false;
+  bool ok = (write (fd, text.data (), text.size ()) == (ssize_t)text.size ());
+  close (fd);
+  return ok;
+}
+
+static inline std::string
+harness_read (const std::string &path)
+{
+  std::string text;
+  int fd = open (path.c_str (), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return text;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read (fd, buf, sizeof(buf))) > 0) text.append (buf, n);
+  close (fd);
+  return text;
+}
+
+/***
+    Call first thing in main().  With --editor this process is a
+    stand-in editor and never returns; otherwise the command that
+    starts one.
+***/
+
+static inline std::string
+harness_editor (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--editor")) {
+    prctl (PR_SET_PDEATHSIG, SIGTERM);
+    while (1) pause ();
+  }
+  char exe[PATH_MAX];
+  ssize_t n = readlink ("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (n <= 0) {
+    perror ("readlink /proc/self/exe");
+    exit (99);
+  }
+  exe[n] = 0;
+  return std::string (exe) + " --editor";
+}
+
+/***
+    edif and edif2 keep their working files in /var/run/user/<uid>/<pid>
+    and expect the parent to be there already.
+***/
+
+static inline void
+harness_need_session_dir (const char *prog)
+{
+  char *parent = NULL;
+  if (asprintf (&parent, "/var/run/user/%d", (int)getuid ()) < 0) exit (99);
+  mkdir (parent, 0700);
+  if (access (parent, W_OK) != 0) {
+    fprintf (stderr, "%s: skipped, cannot write %s\n", prog, parent);
+    exit (77);
+  }
+  free (parent);
+}
+
+/***
+    A fresh directory under /tmp, and its removal.
+***/
+
+static inline std::string
+harness_scratch (const char *prog)
+{
+  char tmpl[PATH_MAX];
+  snprintf (tmpl, sizeof(tmpl), "/tmp/%s.XXXXXX", prog);
+  if (!mkdtemp (tmpl)) {
+    perror ("mkdtemp");
+    exit (99);
+  }
+  return tmpl;
+}
+
+static inline void
+harness_remove (const std::string &path)
+{
+  std::string cmd = "rm -rf '" + path + "'";
+  if (system (cmd.c_str ()) != 0) fprintf (stderr, "cannot remove %s\n",
+					   path.c_str ());
+}
+
+/***
+    The p-th percentile (0 < p <= 100) of samples, exactly: the
+    nearest-rank value, not an interpolation or a histogram bound.
+***/
+
+static inline uint64_t
+harness_percentile (std::vector<uint64_t> &samples, double p)
+{
+  if (samples.empty ()) return 0;
+  size_t rank = (size_t)(p / 100.0 * samples.size () + 0.999999);
+  if (rank < 1) rank = 1;
+  if (rank > samples.size ()) rank = samples.size ();
+  std::nth_element (samples.begin (), samples.begin () + rank - 1,
+		    samples.end ());
+  return samples[rank - 1];
+}
+
+/***
+    A field of /proc/self/status in kB: VmRSS is the resident set now,
+    VmHWM its peak since the start or the last harness_reset_peak().
+***/
+
+static inline long
+harness_status_kb (const char *field)
+{
+  FILE *fp = fopen ("/proc/self/status", "r");
+  if (!fp) return -1;
+  char line[256];
+  size_t len = strlen (field);
+  long kb = -1;
+  while (fgets (line, sizeof(line), fp))
+    if (!strncmp (line, field, len) && line[len] == ':')
+      kb = strtol (line + len + 1, NULL, 10);
+  fclose (fp);
+  return kb;
+}
+
+static inline long
+harness_peak_rss_kb ()
+{
+  return harness_status_kb ("VmHWM");
+}
+
+static inline long
+harness_rss_kb ()
+{
+  return harness_status_kb ("VmRSS");
+}
+
+/***
+    Start the peak over from the resident set now.  Returns false if the
+    kernel won't, in which case the peak is still the whole run's.
+***/
+
+static inline bool
+harness_reset_peak ()
+{
+  int fd = open ("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  bool ok = (write (fd, "5", 1) == 1);
+  close (fd);
+  return ok;
+}
+
+static inline int
+harness_done (const char *prog)
+{
+  if (harness_failures) {
+    fprintf (stderr, "%s: %d checks failed\n", prog, harness_failures);
+    return 1;
+  }
+  printf ("%s: all checks passed\n", prog);
+  return 0;
+}
+
+#endif  // HARNESS_HH
@@ -0,0 +1,76 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REGEX_HEADER_HH
+#define REGEX_HEADER_HH
+
+/***
+    The std::regex header matchers edif used before its scanner, kept
+    as they were so the scanner can be checked and timed against them.
+    They knew only R←, A, F, B and locals, and gave the locals only for
+    niladic headers.  Built on first use rather than at load, so a
+    program can time that too.
+***/
+
+#include <regex>
+#include <string>
+
+typedef struct {
+  std::regex niladic;
+  std::regex monadic;
+  std::regex dyadic;
+} regex_headers_s;
+
+static regex_headers_s *
+regex_headers_build ()
+{
+  const std::string vname ("([A-Za-z∆⍙][A-Za-z0-9_¯∆⍙]*)");
+  const std::string space ("[ \\t]+");
+  const std::string optspace ("[ \\t]*");
+  const std::string leftarrow ("←");
+  const std::string assign ("("+vname+optspace+leftarrow+optspace+")?");
+  const std::string locals  ("((;.*)*)");
+  regex_headers_s *rh = new regex_headers_s;
+  rh->niladic = std::regex (assign+vname+optspace+locals);
+  rh->monadic = std::regex (assign+vname+space+vname+optspace+locals);
+  rh->dyadic  = std::regex (assign+vname+space+vname+space+
+			    vname+optspace+locals);
+  return rh;
+}
+
+static std::string
+regex_parse_header (const regex_headers_s &rh, const char *header,
+		    std::string &locals)
+{
+  std::cmatch m;
+  std::string fcn;
+  if (std::regex_match (header, m, rh.niladic)) {
+    fcn.assign (m[3].first, m[3].second);
+    locals.assign (m[4].first, m[4].second);
+  }
+  else if (std::regex_match (header, m, rh.monadic))
+    fcn.assign (m[3].first, m[3].second);
+  else if (std::regex_match (header, m, rh.dyadic))
+    fcn.assign (m[4].first, m[4].second);
+  return fcn;
+}
+
+#endif  // REGEX_HEADER_HH
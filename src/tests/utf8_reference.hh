@@ -0,0 +1,90 @@
+/*
+    This file is part of GNU APL, a free implementation of the
+    ISO/IEC Standard 13751, "Programming Language APL, Extended"
+
+    Copyright (C) 2008-2013  Dr. Jürgen Sauermann
+    edif Copyright (C) 2020  Dr. C. H. L. Moller
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTF8_REFERENCE_HH
+#define UTF8_REFERENCE_HH
+
+/***
+    A UTF-8 decoder written straight from table 3-7 of the Unicode
+    standard, one byte at a time and with nothing clever in it, for
+    decode_utf8() to be checked and timed against.  A sequence that
+    breaks off becomes one U+FFFD for its maximal subpart, the longest
+    start of it that could still have been well formed; a byte that
+    starts nothing becomes one U+FFFD of its own.
+***/
+
+#include <stdint.h>
+#include <string>
+
+typedef struct {
+  unsigned char first_lo, first_hi;
+  int           trail;		// bytes after the first
+  unsigned char second_lo, second_hi;	// the rest are 80..BF
+} utf8_form_s;
+
+static const utf8_form_s utf8_forms[] = {
+  { 0x00, 0x7f, 0, 0,    0    },
+  { 0xc2, 0xdf, 1, 0x80, 0xbf },
+  { 0xe0, 0xe0, 2, 0xa0, 0xbf },
+  { 0xe1, 0xec, 2, 0x80, 0xbf },
+  { 0xed, 0xed, 2, 0x80, 0x9f },
+  { 0xee, 0xef, 2, 0x80, 0xbf },
+  { 0xf0, 0xf0, 3, 0x90, 0xbf },
+  { 0xf1, 0xf3, 3, 0x80, 0xbf },
+  { 0xf4, 0xf4, 3, 0x80, 0x8f },
+};
+
+static void
+utf8_reference_decode (const std::string &utf, std::u32string &out)
+{
+  size_t i = 0;
+  while (i < utf.size ()) {
+    unsigned char c = utf[i];
+    const utf8_form_s *form = NULL;
+    for (const utf8_form_s &f : utf8_forms)
+      if (c >= f.first_lo && c <= f.first_hi) form = &f;
+    if (!form) {
+      out.push_back (0xfffd);
+      i++;
+      continue;
+    }
+    int good = 0;			// trail bytes that fit the form
+    while (good < form->trail && i + 1 + good < utf.size ()) {
+      unsigned char t = utf[i + 1 + good];
+      unsigned char lo = good ? 0x80 : form->second_lo;
+      unsigned char hi = good ? 0xbf : form->second_hi;
+      if (t < lo || t > hi) break;
+      good++;
+    }
+    if (good < form->trail) {
+      out.push_back (0xfffd);
+      i += 1 + good;
+      continue;
+    }
+    static const unsigned char lead_bits[] = { 0x7f, 0x1f, 0x0f, 0x07 };
+    uint32_t cp = c & lead_bits[form->trail];
+    for (int k = 1; k <= form->trail; k++) cp = (cp << 6) | (utf[i + k] & 0x3f);
+    out.push_back (cp);
+    i += 1 + form->trail;
+  }
+}
+
+#endif  // UTF8_REFERENCE_HH